@@ -0,0 +1,206 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <QItemSelectionModel>
+#include <QStandardItemModel>
+#include <QTest>
+
+#include <kbreadcrumbselectionmodel.h>
+
+#include <algorithm>
+#include <memory>
+
+class tst_KBreadcrumbSelectionModel : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init()
+    {
+        // A
+        //   a1
+        //     x
+        //     y
+        //   a2
+        // B
+        m_model = std::make_unique<QStandardItemModel>();
+        fillModel();
+        m_selectionModel = std::make_unique<QItemSelectionModel>(m_model.get());
+        m_breadcrumbs = std::make_unique<KBreadcrumbSelectionModel>(m_selectionModel.get(), KBreadcrumbSelectionModel::MakeBreadcrumbSelectionInOther);
+    }
+
+    void cleanup()
+    {
+        m_breadcrumbs.reset();
+        m_selectionModel.reset();
+        m_model.reset();
+    }
+
+    void shouldShareAncestors()
+    {
+        // When selecting two children of the same parent
+        select(QStringLiteral("x"));
+        select(QStringLiteral("y"));
+
+        // Then their ancestors should be selected once
+        QCOMPARE(breadcrumbTexts(), QStringLiteral("A,a1,x,y"));
+
+        // When deselecting one of them
+        deselect(QStringLiteral("x"));
+
+        // Then the ancestors should stay selected for the other one
+        QCOMPARE(breadcrumbTexts(), QStringLiteral("A,a1,y"));
+
+        // When deselecting the other one too
+        deselect(QStringLiteral("y"));
+
+        // Then nothing should be selected
+        QCOMPARE(breadcrumbTexts(), QString());
+    }
+
+    void shouldKeepSelectedAncestors()
+    {
+        // Given an ancestor which is selected, and a descendant of it
+        select(QStringLiteral("a1"));
+        select(QStringLiteral("x"));
+        QCOMPARE(breadcrumbTexts(), QStringLiteral("A,a1,x"));
+
+        // When deselecting the ancestor
+        deselect(QStringLiteral("a1"));
+
+        // Then it should stay selected as a breadcrumb of the descendant
+        QCOMPARE(breadcrumbTexts(), QStringLiteral("A,a1,x"));
+
+        // When selecting it again and deselecting the descendant
+        select(QStringLiteral("a1"));
+        deselect(QStringLiteral("x"));
+
+        // Then it should stay selected on its own
+        QCOMPARE(breadcrumbTexts(), QStringLiteral("A,a1"));
+
+        deselect(QStringLiteral("a1"));
+        QCOMPARE(breadcrumbTexts(), QString());
+    }
+
+    void shouldFollowRowChanges()
+    {
+        // Given selected indexes sharing an ancestor
+        select(QStringLiteral("x"));
+        select(QStringLiteral("a2"));
+        QCOMPARE(breadcrumbTexts(), QStringLiteral("A,a1,a2,x"));
+
+        // When inserting a row before the breadcrumbs, and removing a selected row
+        item(QStringLiteral("A"))->insertRow(0, new QStandardItem(QStringLiteral("n")));
+        item(QStringLiteral("a1"))->removeRow(0);
+
+        // Then the breadcrumbs of the removed row only should be deselected
+        QCOMPARE(breadcrumbTexts(), QStringLiteral("A,a2"));
+
+        // And the remaining breadcrumbs should still be deselected with their descendants
+        deselect(QStringLiteral("a2"));
+        QCOMPARE(breadcrumbTexts(), QString());
+
+        // When sorting the model, the breadcrumbs should follow
+        select(QStringLiteral("y"));
+        m_model->sort(0, Qt::DescendingOrder);
+        QCOMPARE(breadcrumbTexts(), QStringLiteral("A,a1,y"));
+        deselect(QStringLiteral("y"));
+        QCOMPARE(breadcrumbTexts(), QString());
+    }
+
+    void shouldHandleReset()
+    {
+        // Given a selection
+        select(QStringLiteral("x"));
+        QCOMPARE(breadcrumbTexts(), QStringLiteral("A,a1,x"));
+
+        // When resetting the model
+        m_model->clear();
+
+        // Then nothing should be selected
+        QCOMPARE(breadcrumbTexts(), QString());
+
+        // And the breadcrumbs should work from scratch
+        fillModel();
+        select(QStringLiteral("y"));
+        QCOMPARE(breadcrumbTexts(), QStringLiteral("A,a1,y"));
+        deselect(QStringLiteral("y"));
+        QCOMPARE(breadcrumbTexts(), QString());
+    }
+
+    void shouldChangeBreadcrumbLength()
+    {
+        // Given a selection with all its ancestors
+        select(QStringLiteral("x"));
+        QCOMPARE(breadcrumbTexts(), QStringLiteral("A,a1,x"));
+
+        // When shortening the breadcrumbs
+        m_breadcrumbs->setBreadcrumbLength(1);
+
+        // Then the ancestors beyond the length should be deselected
+        QCOMPARE(breadcrumbTexts(), QStringLiteral("a1,x"));
+        deselect(QStringLiteral("x"));
+        QCOMPARE(breadcrumbTexts(), QString());
+
+        // When making them longer again
+        select(QStringLiteral("y"));
+        m_breadcrumbs->setBreadcrumbLength(-1);
+
+        // Then all the ancestors should be selected, and deselected with the selection
+        QCOMPARE(breadcrumbTexts(), QStringLiteral("A,a1,y"));
+        deselect(QStringLiteral("y"));
+        QCOMPARE(breadcrumbTexts(), QString());
+    }
+
+private:
+    void fillModel()
+    {
+        auto a = new QStandardItem(QStringLiteral("A"));
+        auto a1 = new QStandardItem(QStringLiteral("a1"));
+        a1->appendRow(new QStandardItem(QStringLiteral("x")));
+        a1->appendRow(new QStandardItem(QStringLiteral("y")));
+        a->appendRow(a1);
+        a->appendRow(new QStandardItem(QStringLiteral("a2")));
+        m_model->appendRow(a);
+        m_model->appendRow(new QStandardItem(QStringLiteral("B")));
+    }
+
+    QStandardItem *item(const QString &text) const
+    {
+        const QList<QStandardItem *> items = m_model->findItems(text, Qt::MatchExactly | Qt::MatchRecursive);
+        Q_ASSERT(items.size() == 1);
+        return items.first();
+    }
+
+    void select(const QString &text)
+    {
+        m_selectionModel->select(item(text)->index(), QItemSelectionModel::Select);
+    }
+
+    void deselect(const QString &text)
+    {
+        m_selectionModel->select(item(text)->index(), QItemSelectionModel::Deselect);
+    }
+
+    QString breadcrumbTexts() const
+    {
+        QStringList texts;
+        const QModelIndexList indexes = m_breadcrumbs->selectedIndexes();
+        for (const QModelIndex &index : indexes) {
+            texts.append(index.data().toString());
+        }
+        std::sort(texts.begin(), texts.end());
+        return texts.join(QLatin1Char(','));
+    }
+
+    std::unique_ptr<QStandardItemModel> m_model;
+    std::unique_ptr<QItemSelectionModel> m_selectionModel;
+    std::unique_ptr<KBreadcrumbSelectionModel> m_breadcrumbs;
+};
+
+QTEST_MAIN(tst_KBreadcrumbSelectionModel)
+
+#include "kbreadcrumbselectionmodeltest.moc"
@@ -0,0 +1,268 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <QAbstractItemModelTester>
+#include <QItemSelectionModel>
+#include <QSignalSpy>
+#include <QStandardItemModel>
+#include <QTest>
+
+#include "test_model_helpers.h"
+#include <algorithm>
+#include <kcheckableproxymodel.h>
+using namespace TestModelHelpers;
+
+// Extracts the check state of all rows under parent: 'x' for checked, '-' for partially checked, '.' for unchecked
+static QString extractCheckStates(QAbstractItemModel *model, const QModelIndex &parent = QModelIndex())
+{
+    QString result;
+    for (int row = 0; row < model->rowCount(parent); ++row) {
+        switch (model->index(row, 0, parent).data(Qt::CheckStateRole).toInt()) {
+        case Qt::Checked:
+            result += QLatin1Char('x');
+            break;
+        case Qt::PartiallyChecked:
+            result += QLatin1Char('-');
+            break;
+        default:
+            result += QLatin1Char('.');
+            break;
+        }
+    }
+    return result;
+}
+
+class tst_KCheckableProxyModel : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+
+    void init()
+    {
+        mod.clear();
+        for (const QString &text : {QStringLiteral("A"), QStringLiteral("B"), QStringLiteral("C"), QStringLiteral("D"), QStringLiteral("E")}) {
+            mod.appendRow(makeStandardItems({text, text.toLower()}));
+        }
+        mod.item(0, 0)->appendRow(makeStandardItems({QStringLiteral("m"), QStringLiteral("-")}));
+        mod.item(0, 0)->appendRow(makeStandardItems({QStringLiteral("n"), QStringLiteral("-")}));
+        mod.item(0, 0)->child(1, 0)->appendRow(makeStandardItems({QStringLiteral("o"), QStringLiteral("-")}));
+    }
+
+    void checkStateFollowsSelection()
+    {
+        QItemSelectionModel selectionModel(&mod);
+        KCheckableProxyModel proxy;
+        proxy.setSourceModel(&mod);
+        proxy.setSelectionModel(&selectionModel);
+        QAbstractItemModelTester modelTest(&proxy);
+
+        QCOMPARE(extractCheckStates(&proxy), QStringLiteral("....."));
+
+        selectionModel.select(QItemSelection(mod.index(1, 0), mod.index(2, 1)), QItemSelectionModel::Select);
+        QCOMPARE(extractCheckStates(&proxy), QStringLiteral(".xx.."));
+
+        // Selecting other columns does not check anything
+        selectionModel.select(QItemSelection(mod.index(4, 1), mod.index(4, 1)), QItemSelectionModel::Select);
+        QCOMPARE(extractCheckStates(&proxy), QStringLiteral(".xx.."));
+        QVERIFY(!proxy.index(4, 1).data(Qt::CheckStateRole).isValid());
+
+        const QModelIndex a = mod.index(0, 0);
+        selectionModel.select(mod.index(1, 0, a), QItemSelectionModel::Select);
+        QCOMPARE(extractCheckStates(&proxy, proxy.index(0, 0)), QStringLiteral(".x"));
+
+        selectionModel.select(mod.index(2, 0), QItemSelectionModel::Deselect);
+        QCOMPARE(extractCheckStates(&proxy), QStringLiteral(".x..."));
+
+        // The check states follow the rows when the source model changes
+        mod.insertRow(0, makeStandardItems({QStringLiteral("Z"), QStringLiteral("z")}));
+        QCOMPARE(extractCheckStates(&proxy), QStringLiteral("..x..."));
+        QCOMPARE(extractCheckStates(&proxy, proxy.index(1, 0)), QStringLiteral(".x"));
+
+        mod.removeRows(0, 2);
+        QCOMPARE(extractCheckStates(&proxy), QStringLiteral("x..."));
+
+        // Checking through the proxy updates the selection
+        QVERIFY(proxy.setData(proxy.index(3, 0), Qt::Checked, Qt::CheckStateRole));
+        QVERIFY(selectionModel.isSelected(mod.index(3, 0)));
+        QCOMPARE(extractCheckStates(&proxy), QStringLiteral("x..x"));
+
+        QVERIFY(proxy.setData(proxy.index(0, 0), Qt::Unchecked, Qt::CheckStateRole));
+        QCOMPARE(extractCheckStates(&proxy), QStringLiteral("...x"));
+
+        selectionModel.clearSelection();
+        QCOMPARE(extractCheckStates(&proxy), QStringLiteral("...."));
+    }
+
+    void checkStateUpToDateInSignals()
+    {
+        // Given a checked row
+        QItemSelectionModel selectionModel(&mod);
+        KCheckableProxyModel proxy;
+        proxy.setSourceModel(&mod);
+        proxy.setSelectionModel(&selectionModel);
+        selectionModel.select(mod.index(1, 0), QItemSelectionModel::Select);
+        QCOMPARE(extractCheckStates(&proxy), QStringLiteral(".x..."));
+
+        QStringList statesInSignals;
+        const auto saveStates = [&] {
+            statesInSignals.append(extractCheckStates(&proxy));
+        };
+        connect(&proxy, &QAbstractItemModel::rowsInserted, &proxy, saveStates);
+        connect(&proxy, &QAbstractItemModel::layoutChanged, &proxy, saveStates);
+
+        // When inserting a row before it, then sorting the rows
+        mod.insertRow(0, makeStandardItems({QStringLiteral("Z"), QStringLiteral("z")}));
+        mod.sort(0, Qt::DescendingOrder);
+
+        // Then the users of the proxy should already see the check states of the new rows
+        QCOMPARE(statesInSignals, QStringList({QStringLiteral("..x..."), QStringLiteral("....x.")}));
+    }
+
+    void changeSelectionModel()
+    {
+        QItemSelectionModel selectionModel(&mod);
+        selectionModel.select(mod.index(0, 0), QItemSelectionModel::Select);
+        QItemSelectionModel otherSelectionModel(&mod);
+        otherSelectionModel.select(mod.index(3, 0), QItemSelectionModel::Select);
+
+        KCheckableProxyModel proxy;
+        proxy.setSourceModel(&mod);
+        proxy.setSelectionModel(&selectionModel);
+        QCOMPARE(extractCheckStates(&proxy), QStringLiteral("x...."));
+
+        proxy.setSelectionModel(&otherSelectionModel);
+        QCOMPARE(extractCheckStates(&proxy), QStringLiteral("...x."));
+
+        // The previous selection model is no longer followed
+        QSignalSpy dataChangedSpy(&proxy, &QAbstractItemModel::dataChanged);
+        selectionModel.select(mod.index(1, 0), QItemSelectionModel::Select);
+        QCOMPARE(dataChangedSpy.count(), 0);
+        QCOMPARE(extractCheckStates(&proxy), QStringLiteral("...x."));
+    }
+
+    void bulkCheckState()
+    {
+        QItemSelectionModel selectionModel(&mod);
+        KCheckableProxyModel proxy;
+        proxy.setSourceModel(&mod);
+        proxy.setSelectionModel(&selectionModel);
+        QAbstractItemModelTester modelTest(&proxy);
+
+        QSignalSpy selectionChangedSpy(&selectionModel, &QItemSelectionModel::selectionChanged);
+        QSignalSpy dataChangedSpy(&proxy, &QAbstractItemModel::dataChanged);
+
+        QItemSelection selection(proxy.index(0, 0), proxy.index(1, 1));
+        selection.select(proxy.index(3, 0), proxy.index(3, 0));
+        selection.select(proxy.index(2, 1), proxy.index(2, 1)); // not checkable, ignored
+        proxy.setCheckState(selection, Qt::Checked);
+        QCOMPARE(extractCheckStates(&proxy), QStringLiteral("xx.x."));
+        QCOMPARE(selectionChangedSpy.count(), 1);
+        QCOMPARE(dataChangedSpy.count(), 2);
+        for (const QList<QVariant> &args : std::as_const(dataChangedSpy)) {
+            QCOMPARE(args.at(0).toModelIndex().column(), 0);
+            QCOMPARE(args.at(1).toModelIndex().column(), 0);
+            QCOMPARE(args.at(2).value<QList<int>>(), QList<int>{Qt::CheckStateRole});
+        }
+        QCOMPARE(dataChangedSpy.at(0).at(0).toModelIndex(), proxy.index(0, 0));
+        QCOMPARE(dataChangedSpy.at(0).at(1).toModelIndex(), proxy.index(1, 0));
+        QCOMPARE(dataChangedSpy.at(1).at(0).toModelIndex(), proxy.index(3, 0));
+
+        // Checking all items notifies the contiguous range once
+        selectionChangedSpy.clear();
+        dataChangedSpy.clear();
+        proxy.setChildrenCheckState(QModelIndex(), Qt::Checked);
+        QCOMPARE(extractCheckStates(&proxy), QStringLiteral("xxxxx"));
+        QCOMPARE(selectionChangedSpy.count(), 1);
+        QCOMPARE(dataChangedSpy.count(), 2); // rows 2 and 4
+        QCOMPARE(dataChangedSpy.at(0).at(0).toModelIndex(), proxy.index(2, 0));
+        QCOMPARE(dataChangedSpy.at(1).at(0).toModelIndex(), proxy.index(4, 0));
+
+        dataChangedSpy.clear();
+        proxy.setChildrenCheckState(QModelIndex(), Qt::Unchecked);
+        QCOMPARE(extractCheckStates(&proxy), QStringLiteral("....."));
+        QCOMPARE(dataChangedSpy.count(), 1);
+        QCOMPARE(dataChangedSpy.at(0).at(0).toModelIndex(), proxy.index(0, 0));
+        QCOMPARE(dataChangedSpy.at(0).at(1).toModelIndex(), proxy.index(4, 0));
+
+        // Children only
+        const QModelIndex a = proxy.index(0, 0);
+        proxy.setChildrenCheckState(a, Qt::Checked);
+        QCOMPARE(extractCheckStates(&proxy), QStringLiteral("....."));
+        QCOMPARE(extractCheckStates(&proxy, a), QStringLiteral("xx"));
+        QCOMPARE(extractCheckStates(&proxy, proxy.index(1, 0, a)), QStringLiteral("."));
+    }
+
+    void tristate()
+    {
+        QItemSelectionModel selectionModel(&mod);
+        KCheckableProxyModel proxy;
+        proxy.setSourceModel(&mod);
+        proxy.setSelectionModel(&selectionModel);
+        QAbstractItemModelTester modelTest(&proxy);
+
+        const QModelIndex a = mod.index(0, 0);
+        const QModelIndex n = mod.index(1, 0, a);
+        const QModelIndex o = mod.index(0, 0, n);
+        selectionModel.select(o, QItemSelectionModel::Select);
+        QCOMPARE(extractCheckStates(&proxy), QStringLiteral("....."));
+
+        QSignalSpy dataChangedSpy(&proxy, &QAbstractItemModel::dataChanged);
+        proxy.setTristate(true);
+        QVERIFY(proxy.isTristate());
+        QCOMPARE(extractCheckStates(&proxy), QStringLiteral("-...."));
+        QCOMPARE(extractCheckStates(&proxy, proxy.mapFromSource(a)), QStringLiteral(".-"));
+        QCOMPARE(extractCheckStates(&proxy, proxy.mapFromSource(n)), QStringLiteral("x"));
+        QCOMPARE(dataChangedSpy.count(), 2); // a and n
+
+        // Only the ancestors whose state changes are notified
+        dataChangedSpy.clear();
+        selectionModel.select(mod.index(0, 0, a), QItemSelectionModel::Select);
+        QCOMPARE(extractCheckStates(&proxy, proxy.mapFromSource(a)), QStringLiteral("x-"));
+        QCOMPARE(dataChangedSpy.count(), 1);
+
+        dataChangedSpy.clear();
+        selectionModel.select(a, QItemSelectionModel::Select);
+        QCOMPARE(extractCheckStates(&proxy), QStringLiteral("x...."));
+        QCOMPARE(dataChangedSpy.count(), 1);
+
+        dataChangedSpy.clear();
+        selectionModel.select(QItemSelection(mod.index(0, 0, a), mod.index(0, 0, a)), QItemSelectionModel::Deselect);
+        selectionModel.select(o, QItemSelectionModel::Deselect);
+        QCOMPARE(extractCheckStates(&proxy), QStringLiteral("x...."));
+        QCOMPARE(extractCheckStates(&proxy, proxy.mapFromSource(a)), QStringLiteral(".."));
+        QCOMPARE(dataChangedSpy.count(), 3); // m, o and n
+
+        // Removing the last checked descendant updates the ancestors
+        selectionModel.select(o, QItemSelectionModel::Select);
+        selectionModel.select(a, QItemSelectionModel::Deselect);
+        QCOMPARE(extractCheckStates(&proxy), QStringLiteral("-...."));
+        dataChangedSpy.clear();
+        mod.removeRow(1, a);
+        QCOMPARE(extractCheckStates(&proxy), QStringLiteral("....."));
+        QVERIFY(std::any_of(dataChangedSpy.cbegin(), dataChangedSpy.cend(), [&](const QList<QVariant> &args) {
+            return args.at(0).toModelIndex() == proxy.index(0, 0);
+        }));
+
+        // Inserting rows does not change the counts
+        selectionModel.select(mod.index(0, 0, a), QItemSelectionModel::Select);
+        mod.item(0, 0)->insertRow(0, makeStandardItems({QStringLiteral("l"), QStringLiteral("-")}));
+        QCOMPARE(extractCheckStates(&proxy), QStringLiteral("-...."));
+        QCOMPARE(extractCheckStates(&proxy, proxy.index(0, 0)), QStringLiteral(".x"));
+
+        dataChangedSpy.clear();
+        proxy.setTristate(false);
+        QCOMPARE(extractCheckStates(&proxy), QStringLiteral("....."));
+        QCOMPARE(dataChangedSpy.count(), 1);
+    }
+
+private:
+    QStandardItemModel mod;
+};
+
+QTEST_MAIN(tst_KCheckableProxyModel)
+
+#include "kcheckableproxymodeltest.moc"
@@ -11,6 +11,20 @@
 
 #include <KColumnHeadersModel>
 
+class CountingHeadersModel : public QStandardItemModel
+{
+public:
+    using QStandardItemModel::QStandardItemModel;
+
+    QVariant headerData(int section, Qt::Orientation orientation, int role) const override
+    {
+        ++headerDataCount;
+        return QStandardItemModel::headerData(section, orientation, role);
+    }
+
+    mutable int headerDataCount = 0;
+};
+
 class KColumnHeadersModelTest : public QObject
 {
     Q_OBJECT
@@ -137,6 +151,40 @@ private Q_SLOTS:
         QCOMPARE(model->data(model->index(1, 0), Qt::DisplayRole).toString(), QStringLiteral("Test 3"));
         QCOMPARE(model->data(model->index(2, 0), Qt::DisplayRole).toString(), QStringLiteral("Test 4"));
     }
+
+    void testCachedHeaders()
+    {
+        auto model = new KColumnHeadersModel{this};
+
+        auto sourceModel = new CountingHeadersModel{this};
+        sourceModel->setHorizontalHeaderLabels({QStringLiteral("Test 1"), QStringLiteral("Test 2"), QStringLiteral("Test 3")});
+
+        model->setSourceModel(sourceModel);
+
+        new QAbstractItemModelTester(model, this);
+
+        QVERIFY(model->roleNames().contains(KColumnHeadersModel::SortRole));
+        QCOMPARE(model->roleNames().value(Qt::DisplayRole), QByteArrayLiteral("display"));
+
+        QCOMPARE(model->data(model->index(1, 0), Qt::DisplayRole).toString(), QStringLiteral("Test 2"));
+        sourceModel->headerDataCount = 0;
+        QCOMPARE(model->data(model->index(1, 0), Qt::DisplayRole).toString(), QStringLiteral("Test 2"));
+        QCOMPARE(sourceModel->headerDataCount, 0);
+
+        // Changed headers are fetched again
+        sourceModel->setHeaderData(1, Qt::Horizontal, QStringLiteral("Changed"));
+        QCOMPARE(model->data(model->index(1, 0), Qt::DisplayRole).toString(), QStringLiteral("Changed"));
+
+        // And so are all headers, once the columns change
+        sourceModel->insertColumn(0);
+        sourceModel->setHeaderData(0, Qt::Horizontal, QStringLiteral("New"));
+        QCOMPARE(model->data(model->index(0, 0), Qt::DisplayRole).toString(), QStringLiteral("New"));
+        QCOMPARE(model->data(model->index(2, 0), Qt::DisplayRole).toString(), QStringLiteral("Changed"));
+
+        sourceModel->removeColumn(0);
+        QCOMPARE(model->data(model->index(0, 0), Qt::DisplayRole).toString(), QStringLiteral("Test 1"));
+        QCOMPARE(model->data(model->index(1, 0), Qt::DisplayRole).toString(), QStringLiteral("Changed"));
+    }
 };
 
 QTEST_MAIN(KColumnHeadersModelTest)
@@ -0,0 +1,106 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <QItemSelection>
+#include <QStandardItemModel>
+#include <QTest>
+
+#include <kextracolumnsproxymodel.h>
+
+static const int s_rowCount = 20000;
+static const int s_columnCount = 4;
+
+class TwoExtraColumnsProxyModel : public KExtraColumnsProxyModel
+{
+public:
+    TwoExtraColumnsProxyModel()
+    {
+        appendColumn(QStringLiteral("Extra1"));
+        appendColumn(QStringLiteral("Extra2"));
+    }
+
+    QVariant extraColumnData(const QModelIndex &parent, int row, int extraColumn, int role) const override
+    {
+        Q_UNUSED(parent);
+        if (role != Qt::DisplayRole) {
+            return QVariant();
+        }
+        return row * 10 + extraColumn;
+    }
+};
+
+/*
+  Maps selections of many ranges, spanning source and extra columns, to the source model.
+*/
+class KExtraColumnsProxyModelBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+
+    void mapDisjointRows();
+    void mapAdjacentRows();
+
+private:
+    QStandardItemModel m_model;
+    TwoExtraColumnsProxyModel m_proxy;
+};
+
+void KExtraColumnsProxyModelBenchmark::initTestCase()
+{
+    m_model.setRowCount(s_rowCount);
+    m_model.setColumnCount(s_columnCount);
+    m_proxy.setSourceModel(&m_model);
+    QCOMPARE(m_proxy.columnCount(), s_columnCount + 2);
+}
+
+void KExtraColumnsProxyModelBenchmark::mapDisjointRows()
+{
+    // 10k disjoint rows, alternately selected in the source columns, the extra columns and all columns
+    QItemSelection selection;
+    for (int row = 0; row < s_rowCount; row += 2) {
+        switch (row % 3) {
+        case 0:
+            selection.select(m_proxy.index(row, 0), m_proxy.index(row, s_columnCount - 1));
+            break;
+        case 1:
+            selection.select(m_proxy.index(row, s_columnCount), m_proxy.index(row, s_columnCount + 1));
+            break;
+        default:
+            selection.select(m_proxy.index(row, 0), m_proxy.index(row, s_columnCount + 1));
+            break;
+        }
+    }
+    QCOMPARE(selection.size(), s_rowCount / 2);
+
+    QItemSelection sourceSelection;
+    QBENCHMARK {
+        sourceSelection = m_proxy.mapSelectionToSource(selection);
+    }
+    QCOMPARE(sourceSelection.size(), s_rowCount / 2);
+}
+
+void KExtraColumnsProxyModelBenchmark::mapAdjacentRows()
+{
+    // 10k adjacent rows, each selected in the source and the extra columns separately
+    QItemSelection selection;
+    for (int row = 0; row < s_rowCount / 2; ++row) {
+        selection.select(m_proxy.index(row, 0), m_proxy.index(row, s_columnCount - 1));
+        selection.select(m_proxy.index(row, s_columnCount), m_proxy.index(row, s_columnCount + 1));
+    }
+
+    QItemSelection sourceSelection;
+    QBENCHMARK {
+        sourceSelection = m_proxy.mapSelectionToSource(selection);
+    }
+    QCOMPARE(sourceSelection.size(), 1);
+    QCOMPARE(sourceSelection.first().height(), s_rowCount / 2);
+}
+
+QTEST_MAIN(KExtraColumnsProxyModelBenchmark)
+
+#include "kextracolumnsproxymodelbenchmark.moc"
@@ -6,15 +6,19 @@
 */
 
 #include <QItemSelectionModel>
+#include <QSemaphore>
 #include <QSignalSpy>
 #include <QSortFilterProxyModel>
 #include <QStandardItemModel>
 #include <QTest>
+#include <QThreadPool>
 
 #include "dynamictreemodel.h"
 
 #include "test_model_helpers.h"
 #include <kextracolumnsproxymodel.h>
+
+#include <memory>
 using namespace TestModelHelpers;
 
 Q_DECLARE_METATYPE(QModelIndex)
@@ -79,6 +83,79 @@ private:
         QChar m_extraColumnData;
     };
 
+    // Counts the calls to extraColumnData
+    class CountingExtraColumnProxyModel : public KExtraColumnsProxyModel
+    {
+    public:
+        CountingExtraColumnProxyModel()
+        {
+            appendColumn(QStringLiteral("Lower"));
+        }
+        QVariant extraColumnData(const QModelIndex &parent, int row, int extraColumn, int role) const override
+        {
+            Q_UNUSED(extraColumn);
+            if (role != Qt::DisplayRole) {
+                return QVariant();
+            }
+            ++m_callCount;
+            return index(row, 0, parent).data().toString().toLower();
+        }
+        mutable int m_callCount = 0;
+    };
+
+    // The extra column is the number of descendants of the row
+    class AggregatingExtraColumnProxyModel : public KExtraColumnsProxyModel
+    {
+    public:
+        AggregatingExtraColumnProxyModel()
+        {
+            appendColumn(QStringLiteral("Descendants"));
+        }
+        QVariant extraColumnData(const QModelIndex &parent, int row, int extraColumn, int role) const override
+        {
+            Q_UNUSED(extraColumn);
+            if (role != Qt::DisplayRole) {
+                return QVariant();
+            }
+            ++m_callCount;
+            return descendantCount(index(row, 0, parent));
+        }
+        int descendantCount(const QModelIndex &parent) const
+        {
+            int count = rowCount(parent);
+            for (int row = 0; row < rowCount(parent); ++row) {
+                count += descendantCount(index(row, 0, parent));
+            }
+            return count;
+        }
+        mutable int m_callCount = 0;
+    };
+
+    // Computes the extra column in the thread pool, once the gate is opened
+    class AsyncExtraColumnProxyModel : public KExtraColumnsProxyModel
+    {
+    public:
+        AsyncExtraColumnProxyModel()
+        {
+            appendColumn(QStringLiteral("Upper"));
+        }
+        QVariant extraColumnData(const QModelIndex &parent, int row, int extraColumn, int role) const override
+        {
+            if (role != Qt::DisplayRole) {
+                return QVariant();
+            }
+            const QString text = index(row, 0, parent).data().toString();
+            const std::shared_ptr<QSemaphore> gate = m_gate;
+            const auto job = [gate, text] {
+                gate->acquire();
+                gate->release();
+                return QVariant(text.toUpper());
+            };
+            return asyncExtraColumnData(parent, row, extraColumn, role, job, QStringLiteral("?"));
+        }
+        const std::shared_ptr<QSemaphore> m_gate = std::make_shared<QSemaphore>();
+    };
+
 private Q_SLOTS:
 
     void initTestCase()
@@ -297,10 +374,266 @@ private Q_SLOTS:
         QCOMPARE(extractHorizontalHeaderTexts(&pm), QStringLiteral("H1H2H3H45H5H6")); // '5' was inserted in there
     }
 
+    void shouldInsertAndRemoveExtraColumnsAtRuntime()
+    {
+        // Given a extra-columns proxy, with one extra column, and persistent indexes in it
+        CountingExtraColumnProxyModel pm;
+        setup(pm);
+        QCOMPARE(pm.columnCount(), 5);
+        const QPersistentModelIndex rootExtra = pm.index(0, 4);
+        const QPersistentModelIndex childExtra = pm.index(1, 4, pm.index(0, 0));
+        const QPersistentModelIndex childSource = pm.index(1, 3, pm.index(0, 0));
+
+        QSignalSpy colATBISpy(&pm, SIGNAL(columnsAboutToBeInserted(QModelIndex, int, int)));
+        QSignalSpy colInsertedSpy(&pm, SIGNAL(columnsInserted(QModelIndex, int, int)));
+        QSignalSpy colATBRSpy(&pm, SIGNAL(columnsAboutToBeRemoved(QModelIndex, int, int)));
+        QSignalSpy colRemovedSpy(&pm, SIGNAL(columnsRemoved(QModelIndex, int, int)));
+        QSignalSpy resetSpy(&pm, SIGNAL(modelReset()));
+
+        // When inserting an extra column before it
+        pm.insertExtraColumn(0, QStringLiteral("First"));
+
+        // Then the proxy should notify its users and move the persistent indexes
+        QCOMPARE(pm.extraColumnCount(), 2);
+        QCOMPARE(pm.columnCount(), 6);
+        QCOMPARE(rowSpyToText(colATBISpy), QStringLiteral("4,4"));
+        QCOMPARE(rowSpyToText(colInsertedSpy), QStringLiteral("4,4"));
+        QCOMPARE(extractHorizontalHeaderTexts(&pm), QStringLiteral("H1H2H3H4FirstLower"));
+        QCOMPARE(rootExtra.column(), 5);
+        QCOMPARE(childExtra.column(), 5);
+        QCOMPARE(childExtra.data().toString(), QStringLiteral("q"));
+        QCOMPARE(childSource.column(), 3);
+
+        // When removing the original extra column
+        pm.removeExtraColumn(1);
+
+        // Then the proxy should notify its users and invalidate its persistent indexes
+        QCOMPARE(pm.extraColumnCount(), 1);
+        QCOMPARE(pm.columnCount(), 5);
+        QCOMPARE(rowSpyToText(colATBRSpy), QStringLiteral("5,5"));
+        QCOMPARE(rowSpyToText(colRemovedSpy), QStringLiteral("5,5"));
+        QCOMPARE(extractHorizontalHeaderTexts(&pm), QStringLiteral("H1H2H3H4First"));
+        QVERIFY(!rootExtra.isValid());
+        QVERIFY(!childExtra.isValid());
+        QCOMPARE(childSource.column(), 3);
+        QCOMPARE(resetSpy.count(), 0);
+    }
+
+    void shouldMapSelectionToSource()
+    {
+        // Given a extra-columns proxy, with two extra columns
+        TwoExtraColumnsProxyModel pm;
+        setup(pm);
+
+        // When mapping a selection with ranges in extra columns and overlapping ranges
+        QItemSelection selection;
+        selection.select(pm.index(0, 4), pm.index(0, 5));
+        selection.select(pm.index(1, 1), pm.index(1, 2));
+        selection.select(pm.index(1, 0), pm.index(1, 5));
+        const QModelIndex a = pm.index(0, 0);
+        selection.select(pm.index(0, 0, a), pm.index(0, 0, a));
+        selection.select(pm.index(1, 0, a), pm.index(1, 1, a));
+        const QItemSelection sourceSelection = pm.mapSelectionToSource(selection);
+
+        // Then the ranges should be clamped to the source columns, starting at column 0,
+        // and merged without duplicates
+        QCOMPARE(sourceSelection.size(), 3);
+        QCOMPARE(sourceSelection.at(0), QItemSelectionRange(mod.index(0, 0), mod.index(1, 3)));
+        const QModelIndex sourceA = mod.index(0, 0);
+        QCOMPARE(sourceSelection.at(1), QItemSelectionRange(mod.index(1, 0, sourceA), mod.index(1, 1, sourceA)));
+        QCOMPARE(sourceSelection.at(2), QItemSelectionRange(mod.index(0, 0, sourceA), mod.index(0, 0, sourceA)));
+    }
+
     // row removal, layoutChanged, modelReset -> same thing, works via QIdentityProxyModel
-    // missing: test for mapSelectionToSource
     // missing: test for moving a row in an underlying model. Problem: QStandardItemModel doesn't implement moveRow...
 
+    void shouldCacheExtraColumnData()
+    {
+        // Given a extra-columns proxy with a cache
+        CountingExtraColumnProxyModel pm;
+        pm.setExtraColumnDataCacheSize(100);
+        QCOMPARE(pm.extraColumnDataCacheSize(), 100);
+        setup(pm);
+
+        // When querying the same cells several times
+        QCOMPARE(pm.index(0, 4).data().toString(), QStringLiteral("a"));
+        QCOMPARE(pm.index(0, 4).data().toString(), QStringLiteral("a"));
+        QCOMPARE(pm.index(1, 4).data().toString(), QStringLiteral("e"));
+        QCOMPARE(pm.index(1, 4).data().toString(), QStringLiteral("e"));
+        QCOMPARE(pm.index(0, 4, pm.index(0, 0)).data().toString(), QStringLiteral("m"));
+        QCOMPARE(pm.index(0, 4, pm.index(0, 0)).data().toString(), QStringLiteral("m"));
+
+        // Then extraColumnData should be called once per cell
+        QCOMPARE(pm.m_callCount, 3);
+
+        // When the source data changes, only that row is invalidated
+        mod.item(0, 0)->setText(QStringLiteral("X"));
+        QCOMPARE(pm.index(0, 4).data().toString(), QStringLiteral("x"));
+        QCOMPARE(pm.index(1, 4).data().toString(), QStringLiteral("e"));
+        QCOMPARE(pm.m_callCount, 4);
+
+        // When the proxy signals a change in an extra column
+        pm.extraColumnDataChanged(QModelIndex(), 1, 0, {Qt::DisplayRole});
+        QCOMPARE(pm.index(1, 4).data().toString(), QStringLiteral("e"));
+        QCOMPARE(pm.m_callCount, 5);
+
+        // When rows are inserted, the values follow their rows
+        mod.insertRow(0, makeStandardItems(QStringList() << QStringLiteral("I") << QStringLiteral("J") << QStringLiteral("K") << QStringLiteral("L")));
+        QCOMPARE(extractRowTexts(&pm, 0), QStringLiteral("IJKLi"));
+        QCOMPARE(extractRowTexts(&pm, 1), QStringLiteral("XBCDx"));
+        QCOMPARE(extractRowTexts(&pm, 2), QStringLiteral("EFGHe"));
+        QCOMPARE(pm.m_callCount, 8);
+
+        // And the values under other parents are kept
+        QCOMPARE(pm.index(0, 4, pm.index(1, 0)).data().toString(), QStringLiteral("m"));
+        QCOMPARE(pm.m_callCount, 8);
+
+        // When rows are removed, the values follow their rows too
+        mod.removeRow(0);
+        QCOMPARE(extractRowTexts(&pm, 0), QStringLiteral("XBCDx"));
+        QCOMPARE(extractRowTexts(&pm, 1), QStringLiteral("EFGHe"));
+        QCOMPARE(pm.index(0, 4, pm.index(0, 0)).data().toString(), QStringLiteral("m"));
+        QCOMPARE(pm.m_callCount, 10);
+    }
+
+    void shouldLimitExtraColumnDataCache()
+    {
+        // Given a extra-columns proxy with a cache for a single row
+        CountingExtraColumnProxyModel pm;
+        pm.setExtraColumnDataCacheSize(1);
+        setup(pm);
+
+        // When alternating between two rows
+        QCOMPARE(pm.index(0, 4).data().toString(), QStringLiteral("a"));
+        QCOMPARE(pm.index(0, 4).data().toString(), QStringLiteral("a"));
+        QCOMPARE(pm.m_callCount, 1);
+        QCOMPARE(pm.index(1, 4).data().toString(), QStringLiteral("e"));
+        QCOMPARE(pm.index(0, 4).data().toString(), QStringLiteral("a"));
+
+        // Then the least recently used row is evicted
+        QCOMPARE(pm.m_callCount, 3);
+
+        // And disabling the cache computes the data every time
+        pm.setExtraColumnDataCacheSize(0);
+        QCOMPARE(pm.index(0, 4).data().toString(), QStringLiteral("a"));
+        QCOMPARE(pm.index(0, 4).data().toString(), QStringLiteral("a"));
+        QCOMPARE(pm.m_callCount, 5);
+    }
+
+    void shouldInvalidateAggregatedExtraColumnData()
+    {
+        // Given a extra-columns proxy with a cache, whose extra column aggregates the descendants of the rows
+        AggregatingExtraColumnProxyModel pm;
+        pm.setExtraColumnDataCacheSize(100);
+        setup(pm);
+        const QModelIndex a = pm.index(0, 0);
+        QCOMPARE(pm.index(0, 4).data().toInt(), 3);
+        QCOMPARE(pm.index(1, 4, a).data().toInt(), 1);
+        QCOMPARE(pm.index(1, 4).data().toInt(), 1);
+        QCOMPARE(pm.m_callCount, 3);
+
+        // When a grandchild is inserted
+        QStandardItem *q = mod.item(0, 0)->child(1, 0);
+        q->appendRow(makeStandardItems(QStringList() << QStringLiteral("v") << QStringLiteral("w") << QStringLiteral("x") << QStringLiteral("y")));
+
+        // Then its ancestors should be computed again, and only them
+        QCOMPARE(pm.index(0, 4).data().toInt(), 4);
+        QCOMPARE(pm.index(1, 4, a).data().toInt(), 2);
+        QCOMPARE(pm.index(1, 4).data().toInt(), 1);
+        QCOMPARE(pm.m_callCount, 5);
+
+        // When it is removed
+        q->removeRow(1);
+
+        // Then its ancestors should be computed again too
+        QCOMPARE(pm.index(0, 4).data().toInt(), 3);
+        QCOMPARE(pm.index(1, 4, a).data().toInt(), 1);
+        QCOMPARE(pm.index(1, 4).data().toInt(), 1);
+        QCOMPARE(pm.m_callCount, 7);
+    }
+
+    void shouldExtendDataChangedToDependentColumns()
+    {
+        // Given a extra-columns proxy whose first and last extra columns depend on the display text of column 0
+        CountingExtraColumnProxyModel pm;
+        setup(pm);
+        pm.insertExtraColumn(1, QStringLiteral("Independent"));
+        pm.insertExtraColumn(2, QStringLiteral("Dependent"));
+        pm.setExtraColumnDependencies(0, {0}, {Qt::DisplayRole});
+        pm.setExtraColumnDependencies(2, {0}, {Qt::DisplayRole});
+        QSignalSpy dataChangedSpy(&pm, &QAbstractItemModel::dataChanged);
+
+        // When the text of column 0 changes
+        mod.item(0, 0)->setText(QStringLiteral("X"));
+
+        // Then the source change should be forwarded with its roles
+        QCOMPARE(dataChangedSpy.count(), 3);
+        QCOMPARE(dataChangedSpy.at(0).at(0).toModelIndex(), pm.index(0, 0));
+        QCOMPARE(dataChangedSpy.at(0).at(1).toModelIndex(), pm.index(0, 0));
+        QVERIFY(dataChangedSpy.at(0).at(2).value<QList<int>>().contains(Qt::DisplayRole));
+        // And each dependent extra column should be notified separately, without the independent one
+        QCOMPARE(dataChangedSpy.at(1).at(0).toModelIndex(), pm.index(0, 4));
+        QCOMPARE(dataChangedSpy.at(1).at(1).toModelIndex(), pm.index(0, 4));
+        QVERIFY(dataChangedSpy.at(1).at(2).value<QList<int>>().isEmpty());
+        QCOMPARE(dataChangedSpy.at(2).at(0).toModelIndex(), pm.index(0, 6));
+        QCOMPARE(dataChangedSpy.at(2).at(1).toModelIndex(), pm.index(0, 6));
+        QVERIFY(dataChangedSpy.at(2).at(2).value<QList<int>>().isEmpty());
+        QCOMPARE(extractRowTexts(&pm, 0), QStringLiteral("XBCDxxx"));
+
+        // When another column or role changes
+        dataChangedSpy.clear();
+        mod.item(0, 2)->setText(QStringLiteral("c"));
+        mod.item(0, 0)->setData(QStringLiteral("tip"), Qt::ToolTipRole);
+
+        // Then the changes should not be extended
+        QCOMPARE(dataChangedSpy.count(), 2);
+        QCOMPARE(dataChangedSpy.at(0).at(1).toModelIndex(), pm.index(0, 2));
+        QCOMPARE(dataChangedSpy.at(1).at(1).toModelIndex(), pm.index(0, 0));
+        QCOMPARE(dataChangedSpy.at(1).at(2).value<QList<int>>(), QList<int>{Qt::ToolTipRole});
+    }
+
+    void shouldComputeExtraColumnDataAsynchronously()
+    {
+        // Given a extra-columns proxy with an asynchronous column
+        AsyncExtraColumnProxyModel pm;
+        setup(pm);
+        QSignalSpy dataChangedSpy(&pm, &QAbstractItemModel::dataChanged);
+
+        // When querying cells, the placeholder is returned until the jobs finish
+        QCOMPARE(pm.index(0, 4).data().toString(), QStringLiteral("?"));
+        QCOMPARE(pm.index(1, 4).data().toString(), QStringLiteral("?"));
+        QCOMPARE(pm.index(1, 4).data().toString(), QStringLiteral("?"));
+        pm.m_gate->release();
+        QThreadPool::globalInstance()->waitForDone();
+
+        // Then the finished cells should be notified at once
+        QTRY_COMPARE(dataChangedSpy.count(), 1);
+        QCOMPARE(dataChangedSpy.at(0).at(0).toModelIndex(), pm.index(0, 4));
+        QCOMPARE(dataChangedSpy.at(0).at(1).toModelIndex(), pm.index(1, 4));
+        QCOMPARE(extractRowTexts(&pm, 0), QStringLiteral("ABCDA"));
+        QCOMPARE(extractRowTexts(&pm, 1), QStringLiteral("EFGHE"));
+    }
+
+    void shouldCancelAsyncExtraColumnDataOfRemovedRows()
+    {
+        // Given a extra-columns proxy with an asynchronous column, and a pending job
+        AsyncExtraColumnProxyModel pm;
+        setup(pm);
+        QSignalSpy dataChangedSpy(&pm, &QAbstractItemModel::dataChanged);
+        QCOMPARE(pm.index(0, 4).data().toString(), QStringLiteral("?"));
+
+        // When the row is removed before the job finishes
+        mod.removeRow(0);
+        pm.m_gate->release();
+        QThreadPool::globalInstance()->waitForDone();
+
+        // Then the result should be discarded, and a job started for the row taking its place
+        QCOMPARE(pm.index(0, 4).data().toString(), QStringLiteral("?"));
+        QTRY_COMPARE(dataChangedSpy.count(), 1);
+        QCOMPARE(dataChangedSpy.at(0).at(0).toModelIndex(), pm.index(0, 4));
+        QCOMPARE(pm.index(0, 4).data().toString(), QStringLiteral("E"));
+    }
+
     void shouldHandleLayoutChanged()
     {
         // Given a extra-columns proxy, with two extra columns
@@ -340,6 +673,50 @@ private Q_SLOTS:
         }
     }
 
+    void shouldHandleLayoutChangedInChildren()
+    {
+        // Given a extra-columns proxy, with two extra columns, over a sorted QSFPM
+        TwoExtraColumnsProxyModel pm;
+        QSortFilterProxyModel proxy;
+        proxy.setSourceModel(&mod);
+        proxy.sort(0);
+        pm.setSourceModel(&proxy);
+        const QModelIndex a = pm.index(0, 0);
+        QCOMPARE(extractRowTexts(&pm, 0, a), QStringLiteral("mnopZ0"));
+        QCOMPARE(extractRowTexts(&pm, 1, a), QStringLiteral("qrstZ1"));
+        // And persistent indexes in the changing parent and elsewhere
+        const QPersistentModelIndex m = pm.index(0, 0, a);
+        const QPersistentModelIndex mExtra = pm.index(0, 4, a);
+        const QPersistentModelIndex q = pm.index(1, 5, a);
+        const QPersistentModelIndex u = pm.index(0, 4, pm.index(1, 0, a));
+        const QPersistentModelIndex e = pm.index(1, 4);
+        QSignalSpy layoutChangedSpy(&pm, &QAbstractItemModel::layoutChanged);
+
+        // When the children of A get sorted differently
+        mod.item(0, 0)->child(0, 0)->setText(QStringLiteral("z"));
+
+        // Then only that parent should have changed
+        QCOMPARE(layoutChangedSpy.count(), 1);
+        const auto parents = layoutChangedSpy.at(0).at(0).value<QList<QPersistentModelIndex>>();
+        QCOMPARE(parents.size(), 1);
+        QCOMPARE(QModelIndex(parents.first()), a);
+        QCOMPARE(extractRowTexts(&pm, 0, a), QStringLiteral("qrstZ0"));
+        QCOMPARE(extractRowTexts(&pm, 1, a), QStringLiteral("znopZ1"));
+
+        // And the persistent indexes should follow their rows
+        QCOMPARE(m.row(), 1);
+        QCOMPARE(m.data().toString(), QStringLiteral("z"));
+        QCOMPARE(mExtra.row(), 1);
+        QCOMPARE(mExtra.column(), 4);
+        QCOMPARE(q.row(), 0);
+        QCOMPARE(q.column(), 5);
+        QCOMPARE(u.parent().row(), 0);
+        QCOMPARE(u.parent().parent(), a);
+        QCOMPARE(u.column(), 4);
+        QCOMPARE(e.row(), 1);
+        QCOMPARE(e.column(), 4);
+    }
+
     void persistIndexOnLayoutChange()
     {
         DynamicTreeModel model;
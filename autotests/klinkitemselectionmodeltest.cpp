@@ -14,6 +14,7 @@
 #include <QStandardItem>
 #include <QStandardItemModel>
 
+#include <QSignalSpy>
 #include <QTest>
 
 void KLinkItemSelectionModelTest::init()
@@ -171,6 +172,43 @@ void KLinkItemSelectionModelTest::testChangeLinkedSelectionModel()
     QCOMPARE(m_subSelectionModel->selection().indexes().first().row(), 2);
 }
 
+void KLinkItemSelectionModelTest::testChangeLinkedSelectionModelSameSelection()
+{
+    const QItemSelection mainSelection(m_mainModel->index(5, 0), m_mainModel->index(8, 0));
+    m_mainSelectionModel->select(mainSelection, QItemSelectionModel::Select);
+    QCOMPARE(m_subSelectionModel->selectedIndexes().count(), 4);
+
+    QItemSelectionModel replacementSelectionModel(m_mainModel, nullptr);
+    replacementSelectionModel.select(QItemSelection(m_mainModel->index(6, 0), m_mainModel->index(9, 0)), QItemSelectionModel::Select);
+
+    QSignalSpy spy(m_subSelectionModel, &QItemSelectionModel::selectionChanged);
+
+    // Only the rows which differ are deselected and selected
+    m_subSelectionModel->setLinkedItemSelectionModel(&replacementSelectionModel);
+    QCOMPARE(spy.count(), 2);
+    QCOMPARE(spy.at(0).at(1).value<QItemSelection>().indexes(), QModelIndexList{m_subModel->index(0, 0)});
+    QCOMPARE(spy.at(1).at(0).value<QItemSelection>().indexes(), QModelIndexList{m_subModel->index(4, 0)});
+    QCOMPARE(m_subSelectionModel->selectedIndexes().count(), 4);
+
+    // Nothing changes if the selections are the same
+    spy.clear();
+    QItemSelectionModel sameSelectionModel(m_mainModel, nullptr);
+    sameSelectionModel.select(replacementSelectionModel.selection(), QItemSelectionModel::Select);
+    m_subSelectionModel->setLinkedItemSelectionModel(&sameSelectionModel);
+    QCOMPARE(spy.count(), 0);
+
+    // Nor if they are split in different ranges
+    QItemSelectionModel splitSelectionModel(m_mainModel, nullptr);
+    for (int row = 6; row <= 9; ++row) {
+        splitSelectionModel.select(m_mainModel->index(row, 0), QItemSelectionModel::Select);
+    }
+    m_subSelectionModel->setLinkedItemSelectionModel(&splitSelectionModel);
+    QCOMPARE(spy.count(), 0);
+    QCOMPARE(m_subSelectionModel->selectedIndexes().count(), 4);
+
+    m_subSelectionModel->setLinkedItemSelectionModel(m_mainSelectionModel);
+}
+
 void KLinkItemSelectionModelTest::testAdditionalLink()
 {
     {
@@ -28,6 +28,7 @@ private Q_SLOTS:
     void testChangeModel();
     void testChangeModelOfExternal();
     void testChangeLinkedSelectionModel();
+    void testChangeLinkedSelectionModelSameSelection();
     void testAdditionalLink();
     void testClearSelection();
 
@@ -0,0 +1,166 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <QIdentityProxyModel>
+#include <QSortFilterProxyModel>
+#include <QStandardItemModel>
+#include <QTest>
+
+#include <kdescendantsproxymodel.h>
+#include <kextracolumnsproxymodel.h>
+#include <kmodelindexproxymapper.h>
+#include <krearrangecolumnsproxymodel.h>
+
+#include <algorithm>
+
+static const int s_mappingCount = 1000000;
+
+class LengthColumnProxyModel : public KExtraColumnsProxyModel
+{
+public:
+    LengthColumnProxyModel()
+    {
+        appendColumn(QStringLiteral("Length"));
+    }
+
+    QVariant extraColumnData(const QModelIndex &parent, int row, int extraColumn, int role) const override
+    {
+        Q_UNUSED(extraColumn);
+        if (role != Qt::DisplayRole) {
+            return QVariant();
+        }
+        return index(row, 0, parent).data().toString().size();
+    }
+};
+
+/*
+  Maps indexes through a chain of six proxies of different kinds:
+
+  \code
+  QStandardItemModel
+  -> QSortFilterProxyModel
+  -> KDescendantsProxyModel
+  -> KRearrangeColumnsProxyModel
+  -> KExtraColumnsProxyModel
+  -> QIdentityProxyModel
+  -> QSortFilterProxyModel
+  \endcode
+*/
+class KModelIndexProxyMapperBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+
+    void mapLeftToRight();
+    void mapRightToLeft();
+    void mapLeftToRightList();
+
+private:
+    QStandardItemModel m_model;
+    QSortFilterProxyModel m_sort;
+    KDescendantsProxyModel m_descendants;
+    KRearrangeColumnsProxyModel m_rearrange;
+    LengthColumnProxyModel m_extraColumns;
+    QIdentityProxyModel m_identity;
+    QSortFilterProxyModel m_filter;
+
+    QModelIndexList m_leftIndexes;
+    QModelIndexList m_rightIndexes;
+};
+
+void KModelIndexProxyMapperBenchmark::initTestCase()
+{
+    m_model.setColumnCount(2);
+    for (int row = 0; row < 100; ++row) {
+        QList<QStandardItem *> parentRow{new QStandardItem(QString::number(row)), new QStandardItem(QStringLiteral("parent"))};
+        for (int childRow = 0; childRow < 9; ++childRow) {
+            parentRow.first()->appendRow({new QStandardItem(QString::number(row * 100 + childRow)), new QStandardItem(QStringLiteral("child"))});
+        }
+        m_model.appendRow(parentRow);
+    }
+
+    m_sort.setSourceModel(&m_model);
+    m_sort.sort(0, Qt::DescendingOrder);
+    m_descendants.setSourceModel(&m_sort);
+    m_rearrange.setSourceColumns({1, 0});
+    m_rearrange.setSourceModel(&m_descendants);
+    m_extraColumns.setSourceModel(&m_rearrange);
+    m_identity.setSourceModel(&m_extraColumns);
+    m_filter.setSourceModel(&m_identity);
+
+    QCOMPARE(m_filter.rowCount(), 1000);
+
+    for (int row = 0; row < m_filter.rowCount(); ++row) {
+        m_rightIndexes << m_filter.index(row, 1);
+    }
+
+    const auto addLeftIndexes = [this](const QModelIndex &parent, auto &addIndexes) -> void {
+        for (int row = 0; row < m_model.rowCount(parent); ++row) {
+            const QModelIndex index = m_model.index(row, 0, parent);
+            m_leftIndexes << index;
+            addIndexes(index, addIndexes);
+        }
+    };
+    addLeftIndexes(QModelIndex(), addLeftIndexes);
+    QCOMPARE(m_leftIndexes.size(), 1000);
+}
+
+void KModelIndexProxyMapperBenchmark::mapLeftToRight()
+{
+    KModelIndexProxyMapper mapper(&m_model, &m_filter);
+    QVERIFY(mapper.isConnected());
+    QVERIFY(mapper.mapLeftToRight(m_leftIndexes.first()).isValid());
+
+    int validCount = 0;
+    QBENCHMARK_ONCE {
+        for (int i = 0; i < s_mappingCount; ++i) {
+            validCount += mapper.mapLeftToRight(m_leftIndexes.at(i % m_leftIndexes.size())).isValid();
+        }
+    }
+    QCOMPARE(validCount, s_mappingCount);
+}
+
+void KModelIndexProxyMapperBenchmark::mapRightToLeft()
+{
+    KModelIndexProxyMapper mapper(&m_model, &m_filter);
+    QVERIFY(mapper.isConnected());
+    QVERIFY(mapper.mapRightToLeft(m_rightIndexes.first()).isValid());
+
+    int validCount = 0;
+    QBENCHMARK_ONCE {
+        for (int i = 0; i < s_mappingCount; ++i) {
+            validCount += mapper.mapRightToLeft(m_rightIndexes.at(i % m_rightIndexes.size())).isValid();
+        }
+    }
+    QCOMPARE(validCount, s_mappingCount);
+}
+
+void KModelIndexProxyMapperBenchmark::mapLeftToRightList()
+{
+    KModelIndexProxyMapper mapper(&m_model, &m_filter);
+    QVERIFY(mapper.isConnected());
+
+    QModelIndexList leftIndexes;
+    leftIndexes.reserve(s_mappingCount);
+    for (int i = 0; i < s_mappingCount; ++i) {
+        leftIndexes << m_leftIndexes.at(i % m_leftIndexes.size());
+    }
+
+    QModelIndexList rightIndexes;
+    QBENCHMARK_ONCE {
+        rightIndexes = mapper.mapLeftToRight(leftIndexes);
+    }
+    QCOMPARE(rightIndexes.size(), s_mappingCount);
+    QVERIFY(std::all_of(rightIndexes.cbegin(), rightIndexes.cend(), [](const QModelIndex &index) {
+        return index.isValid();
+    }));
+}
+
+QTEST_MAIN(KModelIndexProxyMapperBenchmark)
+
+#include "kmodelindexproxymapperbenchmark.moc"
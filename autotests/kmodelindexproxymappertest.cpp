@@ -8,9 +8,12 @@
 #include <QIdentityProxyModel>
 #include <QItemSelection>
 #include <QSignalSpy>
+#include <QSortFilterProxyModel>
 #include <QStringListModel>
 #include <QTest>
 
+#include <memory>
+
 #include "kmodelindexproxymapper.h"
 
 class ModelIndexProxyMapperTest : public QObject
@@ -21,12 +24,15 @@ private Q_SLOTS:
     void init();
 
     void testIndexMapping();
+    void testFilteredIndexMapping();
+    void testIndexListMapping();
     void testSelectionMapping();
     void selfConnection();
     void connectedChangedSimple();
     void connectedChangedComplex();
     void crossWires();
     void isConnected();
+    void destroyedProxy();
 
 private:
     QStringListModel baseModel;
@@ -73,6 +79,59 @@ void ModelIndexProxyMapperTest::testIndexMapping()
     QCOMPARE(mapper.mapRightToLeft(rightIdx), leftIdx);
 }
 
+void ModelIndexProxyMapperTest::testFilteredIndexMapping()
+{
+    QSortFilterProxyModel filter;
+    filter.setSourceModel(&proxy_right1);
+    filter.setFilterRegularExpression(QStringLiteral("^[MW]"));
+
+    KModelIndexProxyMapper mapper(&proxy_left3, &filter);
+    QVERIFY(mapper.isConnected());
+    QCOMPARE(filter.rowCount(), 2);
+
+    // Tuesday is filtered out on the right
+    QVERIFY(!mapper.mapLeftToRight(proxy_left3.index(1, 0)).isValid());
+
+    const QModelIndex rightIdx = mapper.mapLeftToRight(proxy_left3.index(2, 0));
+    QCOMPARE(rightIdx, filter.index(1, 0));
+    QCOMPARE(mapper.mapRightToLeft(rightIdx), proxy_left3.index(2, 0));
+
+    QVERIFY(!mapper.mapLeftToRight(QModelIndex()).isValid());
+    QVERIFY(!mapper.mapRightToLeft(QModelIndex()).isValid());
+}
+
+void ModelIndexProxyMapperTest::testIndexListMapping()
+{
+    QSortFilterProxyModel filter;
+    filter.setSourceModel(&proxy_right1);
+    filter.setFilterRegularExpression(QStringLiteral("^[MW]"));
+
+    KModelIndexProxyMapper mapper(&proxy_left3, &filter);
+    QVERIFY(mapper.isConnected());
+
+    const QModelIndexList leftIndexes{
+        proxy_left3.index(2, 0),
+        proxy_left3.index(1, 0),
+        QModelIndex(),
+        proxy_left3.index(0, 0),
+        proxy_left3.index(0, 0),
+    };
+    const QModelIndexList rightIndexes = mapper.mapLeftToRight(leftIndexes);
+    QCOMPARE(rightIndexes, (QModelIndexList{filter.index(1, 0), QModelIndex(), QModelIndex(), filter.index(0, 0), filter.index(0, 0)}));
+    for (int i = 0; i < leftIndexes.size(); ++i) {
+        QCOMPARE(rightIndexes.at(i), mapper.mapLeftToRight(leftIndexes.at(i)));
+    }
+
+    QCOMPARE(mapper.mapRightToLeft(rightIndexes),
+             (QModelIndexList{proxy_left3.index(2, 0), QModelIndex(), QModelIndex(), proxy_left3.index(0, 0), proxy_left3.index(0, 0)}));
+
+    QVERIFY(mapper.mapLeftToRight(QModelIndexList()).isEmpty());
+
+    proxy_right1.setSourceModel(nullptr);
+    QVERIFY(!mapper.isConnected());
+    QCOMPARE(mapper.mapLeftToRight(leftIndexes), QModelIndexList(leftIndexes.size()));
+}
+
 void ModelIndexProxyMapperTest::testSelectionMapping()
 {
     KModelIndexProxyMapper mapper(&proxy_left3, &proxy_right4);
@@ -191,5 +250,25 @@ void ModelIndexProxyMapperTest::isConnected()
     QVERIFY(mapper2.isConnected());
 }
 
+void ModelIndexProxyMapperTest::destroyedProxy()
+{
+    auto middle = std::make_unique<QIdentityProxyModel>();
+    middle->setSourceModel(&proxy_right1);
+    QIdentityProxyModel right;
+    right.setSourceModel(middle.get());
+
+    KModelIndexProxyMapper mapper(&proxy_left3, &right);
+    QVERIFY(mapper.isConnected());
+    QCOMPARE(mapper.mapLeftToRight(proxy_left3.index(1, 0)), right.index(1, 0));
+
+    QSignalSpy spy(&mapper, SIGNAL(isConnectedChanged()));
+    middle.reset();
+
+    QVERIFY(!mapper.isConnected());
+    QCOMPARE(spy.count(), 1);
+    QVERIFY(!mapper.mapLeftToRight(proxy_left3.index(1, 0)).isValid());
+    QVERIFY(mapper.mapSelectionLeftToRight(QItemSelection(proxy_left3.index(1, 0), proxy_left3.index(1, 0))).isEmpty());
+}
+
 QTEST_MAIN(ModelIndexProxyMapperTest)
 #include "kmodelindexproxymappertest.moc"
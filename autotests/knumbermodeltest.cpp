@@ -7,6 +7,8 @@
 #include <QSignalSpy>
 #include <QTest>
 
+#include <limits>
+
 #include "test_model_helpers.h"
 #include <knumbermodel.h>
 using namespace TestModelHelpers;
@@ -40,8 +42,30 @@ private Q_SLOTS:
         m.setMinimumValue(3);
         m.setMaximumValue(5);
         QSignalSpy resetSpy(&m, &QAbstractItemModel::modelReset);
+        QSignalSpy insertSpy(&m, &QAbstractItemModel::rowsInserted);
+        QSignalSpy removeSpy(&m, &QAbstractItemModel::rowsRemoved);
+
+        // Changing the end of the range only adds or removes rows at the end
         m.setMaximumValue(7);
-        QVERIFY(resetSpy.count() == 1);
+        QCOMPARE(resetSpy.count(), 0);
+        QCOMPARE(rowSpyToText(insertSpy), QStringLiteral("3,4"));
+        QCOMPARE(m.rowCount(), 5);
+        QCOMPARE(m.data(m.index(4, 0), Qt::DisplayRole), QVariant("7"));
+
+        m.setMaximumValue(4.5);
+        QCOMPARE(resetSpy.count(), 0);
+        QCOMPARE(rowSpyToText(removeSpy), QStringLiteral("2,4"));
+        QCOMPARE(m.rowCount(), 2);
+
+        m.setMaximumValue(4.8);
+        QCOMPARE(resetSpy.count(), 0);
+        QCOMPARE(insertSpy.count(), 1);
+        QCOMPARE(removeSpy.count(), 1);
+
+        // Changing the start of the range changes every row
+        m.setMinimumValue(4);
+        QCOMPARE(resetSpy.count(), 1);
+        QCOMPARE(m.data(m.index(0, 0), Qt::DisplayRole), QVariant("4"));
     }
 
     void testStep()
@@ -54,6 +78,64 @@ private Q_SLOTS:
         QCOMPARE(m.data(m.index(2, 0), Qt::DisplayRole), QVariant("3.8"));
     }
 
+    void testExactSteps()
+    {
+        KNumberModel m;
+        m.setMinimumValue(0);
+        m.setMaximumValue(0.3);
+        m.setStepSize(0.1);
+        // (0.3 - 0) / 0.1 is slightly below 3 in floating point
+        QCOMPARE(m.rowCount(), 4);
+        QVERIFY(m.value(m.index(3, 0)) == 0.3);
+
+        // Fine steps over a large range don't accumulate errors, and are limited to what an int allows
+        m.setMaximumValue(1e7);
+        m.setStepSize(0.001);
+        QCOMPARE(m.rowCount(), std::numeric_limits<int>::max());
+        QVERIFY(m.value(m.index(1234567891, 0)) == 1234567.891);
+    }
+
+    void testMaximumWithManyDecimals()
+    {
+        KNumberModel m;
+        m.setMinimumValue(0);
+        m.setMaximumValue(1);
+        m.setStepSize(0.1);
+        QCOMPARE(m.rowCount(), 11);
+        QSignalSpy resetSpy(&m, &QAbstractItemModel::modelReset);
+        QSignalSpy insertSpy(&m, &QAbstractItemModel::rowsInserted);
+
+        // A maximum with more decimals than the step doesn't change the existing values
+        m.setMaximumValue(1.0000000001);
+        QCOMPARE(m.rowCount(), 11);
+        QVERIFY(m.value(m.index(3, 0)) == 0.3);
+
+        m.setMaximumValue(1.1000000001);
+        QCOMPARE(rowSpyToText(insertSpy), QStringLiteral("11,11"));
+        QVERIFY(m.value(m.index(11, 0)) == 1.1);
+        QCOMPARE(resetSpy.count(), 0);
+    }
+
+    void testIndexForValue()
+    {
+        KNumberModel m;
+        m.setMinimumValue(3);
+        m.setMaximumValue(4);
+        m.setStepSize(0.2);
+        QCOMPARE(m.indexForValue(3), m.index(0, 0));
+        QCOMPARE(m.indexForValue(3.6), m.index(3, 0));
+        QCOMPARE(m.indexForValue(4), m.index(5, 0));
+        QVERIFY(!m.indexForValue(3.5).isValid());
+        QVERIFY(!m.indexForValue(2.8).isValid());
+        QVERIFY(!m.indexForValue(4.2).isValid());
+
+        // Also without fixed point
+        m.setStepSize(1.0 / 3);
+        QCOMPARE(m.rowCount(), 4);
+        QCOMPARE(m.indexForValue(3 + 2.0 / 3), m.index(2, 0));
+        QVERIFY(!m.indexForValue(3.5).isValid());
+    }
+
     void testLocale()
     {
         KNumberModel m;
@@ -64,6 +146,13 @@ private Q_SLOTS:
 
         m.setFormattingOptions(QLocale::OmitGroupSeparator);
         QCOMPARE(m.data(m.index(0, 0), Qt::DisplayRole), QVariant("1000"));
+
+        // A change of the default locale is picked up, with the same formatting options
+        m.setFormattingOptions(QLocale::DefaultNumberOptions);
+        QLocale::setDefault(QLocale(QLocale::German, QLocale::Germany));
+        QCOMPARE(m.data(m.index(0, 0), Qt::DisplayRole), QVariant("1.000"));
+        m.setFormattingOptions(QLocale::OmitGroupSeparator);
+        QCOMPARE(m.data(m.index(0, 0), Qt::DisplayRole), QVariant("1000"));
     }
 
 private:
@@ -97,12 +97,20 @@ private Q_SLOTS:
         QCOMPARE(pm.proxyColumnForSourceColumn(1), 1);
         QCOMPARE(pm.proxyColumnForSourceColumn(2), -1);
         QCOMPARE(pm.proxyColumnForSourceColumn(3), 0);
+        QCOMPARE(pm.proxyColumnForSourceColumn(4), -1);
         QCOMPARE(pm.sourceColumnForProxyColumn(0), 3);
         QCOMPARE(pm.sourceColumnForProxyColumn(1), 1);
         QCOMPARE(pm.sourceColumnForProxyColumn(2), 0);
 
         // And mapFromSource should return invalid for unmapped cells
         QVERIFY(!pm.mapFromSource(sourceModel.index(0, 2)).isValid());
+
+        // And the mapping should follow changes of the source columns
+        pm.setSourceColumns(QList<int>() << 2 << 0);
+        QCOMPARE(pm.proxyColumnForSourceColumn(0), 1);
+        QCOMPARE(pm.proxyColumnForSourceColumn(1), -1);
+        QCOMPARE(pm.proxyColumnForSourceColumn(2), 0);
+        QCOMPARE(pm.proxyColumnForSourceColumn(3), -1);
     }
 
     void shouldShowNothingIfNoRows()
@@ -240,6 +248,81 @@ private Q_SLOTS:
         QCOMPARE(pm.columnCount(), 0);
     }
 
+    void shouldChangeColumnsWithoutReset()
+    {
+        // Given a rearrange-columns proxy showing "CDBA"
+        KRearrangeColumnsProxyModel pm;
+        new QAbstractItemModelTester(&pm, &pm);
+        setup(pm);
+        const QPersistentModelIndex c = pm.index(0, 0);
+        const QPersistentModelIndex a = pm.index(0, 3);
+        const QPersistentModelIndex t = pm.index(1, 1, pm.index(0, 0));
+        const QPersistentModelIndex r = pm.index(1, 2, pm.index(0, 0));
+        QCOMPARE(t.data().toString(), QStringLiteral("t"));
+        QCOMPARE(r.data().toString(), QStringLiteral("r"));
+
+        QSignalSpy resetSpy(&pm, &QAbstractItemModel::modelReset);
+        QSignalSpy columnsRemovedSpy(&pm, &QAbstractItemModel::columnsRemoved);
+        QSignalSpy columnsInsertedSpy(&pm, &QAbstractItemModel::columnsInserted);
+        QSignalSpy layoutChangedSpy(&pm, &QAbstractItemModel::layoutChanged);
+
+        // When hiding B and A, swapping C and D and showing E
+        pm.setSourceColumns(QList<int>() << 3 << 4 << 2);
+
+        // Then the columns should be removed, moved and inserted without a reset
+        QCOMPARE(extractRowTexts(&pm, 0), QStringLiteral("DEC"));
+        QCOMPARE(extractRowTexts(&pm, 1, pm.index(0, 0)), QStringLiteral("t-s"));
+        QCOMPARE(extractHorizontalHeaderTexts(&pm), QStringLiteral("H4H5H3"));
+        QCOMPARE(resetSpy.count(), 0);
+        QCOMPARE(columnsRemovedSpy.count(), 1);
+        QCOMPARE(columnsRemovedSpy.at(0).at(1).toInt(), 2);
+        QCOMPARE(columnsRemovedSpy.at(0).at(2).toInt(), 3);
+        QCOMPARE(layoutChangedSpy.count(), 1);
+        QCOMPARE(layoutChangedSpy.at(0).at(1).value<QAbstractItemModel::LayoutChangeHint>(), QAbstractItemModel::HorizontalSortHint);
+        QCOMPARE(columnsInsertedSpy.count(), 1);
+        QCOMPARE(columnsInsertedSpy.at(0).at(1).toInt(), 1);
+        QCOMPARE(columnsInsertedSpy.at(0).at(2).toInt(), 1);
+
+        // And the persistent indexes should follow their source columns, in children too
+        QCOMPARE(c.column(), 2);
+        QCOMPARE(c.data().toString(), QStringLiteral("C"));
+        QCOMPARE(t.column(), 0);
+        QCOMPARE(t.data().toString(), QStringLiteral("t"));
+        QVERIFY(!a.isValid());
+        QVERIFY(!r.isValid());
+
+        // And reordering only should be a single layout change
+        pm.setSourceColumns(QList<int>() << 2 << 3 << 4);
+        QCOMPARE(extractRowTexts(&pm, 0), QStringLiteral("CDE"));
+        QCOMPARE(c.column(), 0);
+        QCOMPARE(t.column(), 1);
+        QCOMPARE(layoutChangedSpy.count(), 2);
+        QCOMPARE(columnsRemovedSpy.count(), 1);
+        QCOMPARE(columnsInsertedSpy.count(), 1);
+        QCOMPARE(resetSpy.count(), 0);
+
+        // And showing a column twice should insert the copy
+        pm.setSourceColumns(QList<int>() << 4 << 4 << 2);
+        QCOMPARE(extractRowTexts(&pm, 0), QStringLiteral("EEC"));
+        QCOMPARE(extractHorizontalHeaderTexts(&pm), QStringLiteral("H5H5H3"));
+        QCOMPARE(c.column(), 2);
+        QCOMPARE(columnsRemovedSpy.count(), 2);
+        QCOMPARE(columnsRemovedSpy.at(1).at(1).toInt(), 1);
+        QCOMPARE(layoutChangedSpy.count(), 3);
+        QCOMPARE(columnsInsertedSpy.count(), 2);
+        QCOMPARE(columnsInsertedSpy.at(1).at(1).toInt(), 1);
+        QCOMPARE(columnsInsertedSpy.at(1).at(2).toInt(), 1);
+
+        // And hiding the copy again should remove it
+        pm.setSourceColumns(QList<int>() << 2 << 4);
+        QCOMPARE(extractRowTexts(&pm, 0), QStringLiteral("CE"));
+        QCOMPARE(c.column(), 0);
+        QCOMPARE(columnsRemovedSpy.count(), 3);
+        QCOMPARE(columnsRemovedSpy.at(2).at(1).toInt(), 1);
+        QCOMPARE(columnsInsertedSpy.count(), 2);
+        QCOMPARE(resetSpy.count(), 0);
+    }
+
 private:
     // setup proxy
     void setup(KRearrangeColumnsProxyModel &pm)
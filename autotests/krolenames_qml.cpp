@@ -24,6 +24,7 @@ private Q_SLOTS:
     void testAttachedInvalidRoleName();
     void testAttachedRoleToRoleName();
     void testAttachedRoleNameToRole();
+    void testAttachedRoleNamesAfterReset();
 
 private:
     QAbstractItemModel *createMonthTestModel(QObject *parent = nullptr);
@@ -159,6 +160,45 @@ void tst_KRoleNamesQml::testAttachedRoleToRoleName()
     QCOMPARE(roleName, "user");
 }
 
+void tst_KRoleNamesQml::testAttachedRoleNamesAfterReset()
+{
+    QQmlApplicationEngine app;
+    std::unique_ptr<QStandardItemModel> model{static_cast<QStandardItemModel *>(createMonthTestModel(nullptr))};
+    app.setInitialProperties({{"model", QVariant::fromValue(&*model)}});
+    app.loadData(R"(
+        import QtQml
+        import org.kde.kitemmodels as KItemModels
+
+        QtObject {
+            required property var model
+
+            function role(roleName) {
+                return model.KItemModels.KRoleNames.role(roleName);
+            }
+            function roleName(role) {
+                return model.KItemModels.KRoleNames.roleName(role);
+            }
+        }
+    )");
+    QCOMPARE(app.rootObjects().count(), 1);
+    const auto object = app.rootObjects().first();
+
+    QVariant result;
+    QVERIFY(QMetaObject::invokeMethod(object, "role", Q_RETURN_ARG(QVariant, result), Q_ARG(QVariant, QStringLiteral("user"))));
+    QCOMPARE(result.toInt(), Qt::UserRole);
+
+    // The role names are only allowed to change on reset
+    model->setItemRoleNames({{Qt::UserRole, "month"}, {Qt::DisplayRole, "display"}});
+    model->clear();
+
+    QVERIFY(QMetaObject::invokeMethod(object, "role", Q_RETURN_ARG(QVariant, result), Q_ARG(QVariant, QStringLiteral("user"))));
+    QCOMPARE(result.toInt(), -1);
+    QVERIFY(QMetaObject::invokeMethod(object, "role", Q_RETURN_ARG(QVariant, result), Q_ARG(QVariant, QStringLiteral("month"))));
+    QCOMPARE(result.toInt(), Qt::UserRole);
+    QVERIFY(QMetaObject::invokeMethod(object, "roleName", Q_RETURN_ARG(QVariant, result), Q_ARG(QVariant, int(Qt::UserRole))));
+    QCOMPARE(result.toString(), QStringLiteral("month"));
+}
+
 QTEST_GUILESS_MAIN(tst_KRoleNamesQml)
 
 #include "krolenames_qml.moc"
@@ -0,0 +1,281 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "dynamictreemodel.h"
+
+#include <kselectionproxymodel.h>
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTest>
+
+#include <memory>
+
+/*
+  Benchmarks the KSelectionProxyModel with each filter behavior on a large DynamicTreeModel.
+
+  Besides the usual QTest benchmark output, the measured times are written as JSON to the
+  file named by the KITEMMODELS_BENCHMARK_JSON environment variable, if set, so that they
+  can be compared between builds:
+
+  \code
+  {
+    "selectMany": { "SubTrees": 1234567, ... },
+    ...
+  }
+  \endcode
+
+  Times are in nanoseconds.
+*/
+
+static const int s_rootCount = 200;
+static const int s_childCount = 10;
+static const int s_grandChildCount = 10;
+
+struct Fixture {
+    explicit Fixture(KSelectionProxyModel::FilterBehavior behavior)
+        : tree(new DynamicTreeModel)
+        , selectionModel(new QItemSelectionModel(tree.get()))
+        , proxy(new KSelectionProxyModel(selectionModel.get()))
+    {
+        insertRows({}, s_rootCount);
+        for (int root = 0; root < s_rootCount; ++root) {
+            insertRows({root}, s_childCount);
+            for (int child = 0; child < s_childCount; ++child) {
+                insertRows({root, child}, s_grandChildCount);
+            }
+        }
+
+        proxy->setFilterBehavior(behavior);
+        proxy->setSourceModel(tree.get());
+    }
+
+    void insertRows(const QList<int> &ancestors, int count)
+    {
+        ModelInsertCommand ins(tree.get());
+        ins.setAncestorRowNumbers(ancestors);
+        ins.setStartRow(0);
+        ins.setEndRow(count - 1);
+        ins.doCommand();
+    }
+
+    // Every other root, and the first child of each of them, as separate ranges.
+    QItemSelection manyRanges() const
+    {
+        QItemSelection selection;
+        for (int row = 0; row < s_rootCount; row += 2) {
+            const QModelIndex root = tree->index(row, 0);
+            selection.select(root, root);
+            const QModelIndex child = tree->index(0, 0, root);
+            selection.select(child, child);
+        }
+        return selection;
+    }
+
+    const std::unique_ptr<DynamicTreeModel> tree;
+    const std::unique_ptr<QItemSelectionModel> selectionModel;
+    const std::unique_ptr<KSelectionProxyModel> proxy;
+};
+
+class KSelectionProxyModelBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void cleanupTestCase();
+
+    void selectMany_data();
+    void selectMany();
+    void deselectMany_data();
+    void deselectMany();
+    void insertUnderRoot_data();
+    void insertUnderRoot();
+    void removeRoot_data();
+    void removeRoot();
+    void layoutChange_data();
+    void layoutChange();
+    void reset_data();
+    void reset();
+
+private:
+    void addBehaviors();
+    void record(qint64 nsecs);
+
+    QJsonObject m_results;
+};
+
+void KSelectionProxyModelBenchmark::addBehaviors()
+{
+    QTest::addColumn<int>("kspm_mode");
+
+    QTest::newRow("SubTrees") << static_cast<int>(KSelectionProxyModel::SubTrees);
+    QTest::newRow("SubTreeRoots") << static_cast<int>(KSelectionProxyModel::SubTreeRoots);
+    QTest::newRow("SubTreesWithoutRoots") << static_cast<int>(KSelectionProxyModel::SubTreesWithoutRoots);
+    QTest::newRow("ExactSelection") << static_cast<int>(KSelectionProxyModel::ExactSelection);
+    QTest::newRow("ChildrenOfExactSelection") << static_cast<int>(KSelectionProxyModel::ChildrenOfExactSelection);
+}
+
+void KSelectionProxyModelBenchmark::record(qint64 nsecs)
+{
+    const QString function = QString::fromLatin1(QTest::currentTestFunction());
+    QJsonObject functionResults = m_results.value(function).toObject();
+    functionResults.insert(QString::fromLatin1(QTest::currentDataTag()), nsecs);
+    m_results.insert(function, functionResults);
+}
+
+void KSelectionProxyModelBenchmark::cleanupTestCase()
+{
+    const QString fileName = qEnvironmentVariable("KITEMMODELS_BENCHMARK_JSON");
+    if (fileName.isEmpty()) {
+        return;
+    }
+    QFile file(fileName);
+    QVERIFY2(file.open(QIODevice::WriteOnly | QIODevice::Truncate), qPrintable(file.errorString()));
+    file.write(QJsonDocument(m_results).toJson());
+}
+
+void KSelectionProxyModelBenchmark::selectMany_data()
+{
+    addBehaviors();
+}
+
+void KSelectionProxyModelBenchmark::selectMany()
+{
+    QFETCH(int, kspm_mode);
+    Fixture fixture(static_cast<KSelectionProxyModel::FilterBehavior>(kspm_mode));
+    const QItemSelection selection = fixture.manyRanges();
+
+    QElapsedTimer timer;
+    timer.start();
+    QBENCHMARK_ONCE {
+        fixture.selectionModel->select(selection, QItemSelectionModel::Select);
+    }
+    record(timer.nsecsElapsed());
+
+    QVERIFY(fixture.proxy->rowCount() > 0);
+}
+
+void KSelectionProxyModelBenchmark::deselectMany_data()
+{
+    addBehaviors();
+}
+
+void KSelectionProxyModelBenchmark::deselectMany()
+{
+    QFETCH(int, kspm_mode);
+    Fixture fixture(static_cast<KSelectionProxyModel::FilterBehavior>(kspm_mode));
+    const QItemSelection selection = fixture.manyRanges();
+    fixture.selectionModel->select(selection, QItemSelectionModel::Select);
+
+    QElapsedTimer timer;
+    timer.start();
+    QBENCHMARK_ONCE {
+        fixture.selectionModel->select(selection, QItemSelectionModel::Deselect);
+    }
+    record(timer.nsecsElapsed());
+
+    QCOMPARE(fixture.proxy->rowCount(), 0);
+}
+
+void KSelectionProxyModelBenchmark::insertUnderRoot_data()
+{
+    addBehaviors();
+}
+
+void KSelectionProxyModelBenchmark::insertUnderRoot()
+{
+    QFETCH(int, kspm_mode);
+    Fixture fixture(static_cast<KSelectionProxyModel::FilterBehavior>(kspm_mode));
+    fixture.selectionModel->select(fixture.manyRanges(), QItemSelectionModel::Select);
+
+    ModelInsertCommand ins(fixture.tree.get());
+    ins.setAncestorRowNumbers({0});
+    ins.setStartRow(0);
+    ins.setEndRow(999);
+
+    QElapsedTimer timer;
+    timer.start();
+    QBENCHMARK_ONCE {
+        ins.doCommand();
+    }
+    record(timer.nsecsElapsed());
+}
+
+void KSelectionProxyModelBenchmark::removeRoot_data()
+{
+    addBehaviors();
+}
+
+void KSelectionProxyModelBenchmark::removeRoot()
+{
+    QFETCH(int, kspm_mode);
+    Fixture fixture(static_cast<KSelectionProxyModel::FilterBehavior>(kspm_mode));
+    fixture.selectionModel->select(fixture.manyRanges(), QItemSelectionModel::Select);
+
+    ModelRemoveCommand rem(fixture.tree.get());
+    rem.setAncestorRowNumbers({});
+    rem.setStartRow(0);
+    rem.setEndRow(0);
+
+    QElapsedTimer timer;
+    timer.start();
+    QBENCHMARK_ONCE {
+        rem.doCommand();
+    }
+    record(timer.nsecsElapsed());
+}
+
+void KSelectionProxyModelBenchmark::layoutChange_data()
+{
+    addBehaviors();
+}
+
+void KSelectionProxyModelBenchmark::layoutChange()
+{
+    QFETCH(int, kspm_mode);
+    Fixture fixture(static_cast<KSelectionProxyModel::FilterBehavior>(kspm_mode));
+    fixture.selectionModel->select(fixture.manyRanges(), QItemSelectionModel::Select);
+    const int rowCount = fixture.proxy->rowCount();
+
+    QElapsedTimer timer;
+    timer.start();
+    QBENCHMARK_ONCE {
+        Q_EMIT fixture.tree->layoutAboutToBeChanged();
+        Q_EMIT fixture.tree->layoutChanged();
+    }
+    record(timer.nsecsElapsed());
+
+    QCOMPARE(fixture.proxy->rowCount(), rowCount);
+}
+
+void KSelectionProxyModelBenchmark::reset_data()
+{
+    addBehaviors();
+}
+
+void KSelectionProxyModelBenchmark::reset()
+{
+    QFETCH(int, kspm_mode);
+    Fixture fixture(static_cast<KSelectionProxyModel::FilterBehavior>(kspm_mode));
+    fixture.selectionModel->select(fixture.manyRanges(), QItemSelectionModel::Select);
+
+    ModelResetCommand resetCommand(fixture.tree.get());
+
+    QElapsedTimer timer;
+    timer.start();
+    QBENCHMARK_ONCE {
+        resetCommand.doCommand();
+    }
+    record(timer.nsecsElapsed());
+
+    QCOMPARE(fixture.proxy->rowCount(), 0);
+}
+
+QTEST_MAIN(KSelectionProxyModelBenchmark)
+
+#include "kselectionproxymodelbenchmark.moc"
@@ -15,11 +15,26 @@
 
 #include <QIdentityProxyModel>
 #include <QSignalSpy>
+#include <QStandardItemModel>
 #include <QStringListModel>
 #include <QTest>
 
 using namespace TestModelHelpers;
 
+static QString treeToText(const QAbstractItemModel *model, const QModelIndex &parent = QModelIndex())
+{
+    QString result;
+    for (int row = 0; row < model->rowCount(parent); ++row) {
+        const QModelIndex idx = model->index(row, 0, parent);
+        result += idx.data().toString();
+        if (model->hasChildren(idx)) {
+            result += QLatin1Char('(') + treeToText(model, idx) + QLatin1Char(')');
+        }
+        result += QLatin1Char(' ');
+    }
+    return result;
+}
+
 class KSelectionProxyModelTest : public QObject
 {
     Q_OBJECT
@@ -34,6 +49,8 @@ private Q_SLOTS:
     void columnCountShouldBeStable();
     void selectOnSourceReset();
     void selectionMapping();
+    void selectionRangeMapping_data();
+    void selectionRangeMapping();
     void removeRows_data();
     void removeRows();
 
@@ -41,6 +58,14 @@ private Q_SLOTS:
     void deselection_data();
     void deselection();
 
+    void lazyParentMappings();
+
+    void sortChildren_data();
+    void sortChildren();
+
+    void switchFilterBehavior_data();
+    void switchFilterBehavior();
+
 private:
     const QStringList days;
 };
@@ -599,6 +624,258 @@ void KSelectionProxyModelTest::removeRows()
     QCOMPARE(proxy.rowCount(), expectedRowCountAfter);
 }
 
+void KSelectionProxyModelTest::lazyParentMappings()
+{
+    DynamicTreeModel tree;
+    ModelResetCommand resetCommand(&tree);
+    resetCommand.setInitialTree(
+        " - 1"
+        " - - 2"
+        " - - - 3"
+        " - - - - 4"
+        " - - - - - 5"
+        " - - - - - 6"
+        " - - - - - - 7"
+        " - - - - 8"
+        " - - - 9"
+        " - - - - 10"
+        " - - - - 11"
+        " - - - - - 12"
+        " - - 15"
+        " - - - 16");
+    resetCommand.doCommand();
+
+    QItemSelectionModel selectionModel(&tree);
+
+    KSelectionProxyModel persistentProxy(&selectionModel);
+    persistentProxy.setSourceModel(&tree);
+
+    KSelectionProxyModel lazyProxy(&selectionModel);
+    new ModelTest(&lazyProxy, &lazyProxy);
+    lazyProxy.setLazyParentMappings(true);
+    lazyProxy.setSourceModel(&tree);
+    QVERIFY(lazyProxy.lazyParentMappings());
+
+    const auto findIndex = [&tree](const QString &text) {
+        const QModelIndexList idxs = tree.match(tree.index(0, 0), Qt::DisplayRole, text, 1, Qt::MatchRecursive);
+        return idxs.isEmpty() ? QModelIndex() : idxs.first();
+    };
+
+    const QModelIndex idx2 = findIndex(QStringLiteral("2"));
+    const QModelIndex idx15 = findIndex(QStringLiteral("15"));
+    selectionModel.select(idx2, QItemSelectionModel::Select);
+    selectionModel.select(idx15, QItemSelectionModel::Select);
+
+    QCOMPARE(treeToText(&lazyProxy), treeToText(&persistentProxy));
+
+    // Mapping a deep index creates mappings for all of its ancestors
+    const QPersistentModelIndex idx7 = findIndex(QStringLiteral("7"));
+    const QPersistentModelIndex proxy7 = lazyProxy.mapFromSource(idx7);
+    QVERIFY(proxy7.isValid());
+    QCOMPARE(proxy7.data().toString(), QStringLiteral("7"));
+    QCOMPARE(lazyProxy.mapToSource(proxy7), QModelIndex(idx7));
+
+    // Rows inserted above the selection and inside of it shift the rows of mapped parents
+    {
+        ModelInsertCommand insert(&tree);
+        insert.setStartRow(0);
+        insert.setEndRow(1);
+        insert.doCommand();
+    }
+    {
+        ModelInsertCommand insert(&tree);
+        insert.setAncestorRowNumbers(tree.indexToPath(findIndex(QStringLiteral("2"))));
+        insert.setStartRow(0);
+        insert.setEndRow(0);
+        insert.doCommand();
+    }
+    QCOMPARE(treeToText(&lazyProxy), treeToText(&persistentProxy));
+    QVERIFY(proxy7.isValid());
+    QCOMPARE(proxy7.data().toString(), QStringLiteral("7"));
+    QCOMPARE(lazyProxy.mapToSource(proxy7), QModelIndex(idx7));
+
+    // Removing a mapped parent drops the mappings of its descendants
+    {
+        const QModelIndex idx9 = findIndex(QStringLiteral("9"));
+        ModelRemoveCommand remove(&tree);
+        remove.setAncestorRowNumbers(tree.indexToPath(idx9.parent()));
+        remove.setStartRow(idx9.row());
+        remove.setEndRow(idx9.row());
+        remove.doCommand();
+    }
+    {
+        const QModelIndex idx4 = findIndex(QStringLiteral("4"));
+        ModelRemoveCommand remove(&tree);
+        remove.setAncestorRowNumbers(tree.indexToPath(idx4.parent()));
+        remove.setStartRow(idx4.row());
+        remove.setEndRow(idx4.row());
+        remove.doCommand();
+    }
+    QVERIFY(!proxy7.isValid());
+    QCOMPARE(treeToText(&lazyProxy), treeToText(&persistentProxy));
+
+    selectionModel.select(findIndex(QStringLiteral("15")), QItemSelectionModel::Deselect);
+    QCOMPARE(treeToText(&lazyProxy), treeToText(&persistentProxy));
+}
+
+void KSelectionProxyModelTest::sortChildren_data()
+{
+    QTest::addColumn<int>("kspm_mode");
+    QTest::addColumn<bool>("lazyParentMappings");
+
+    for (const bool lazy : {false, true}) {
+        const QByteArray suffix = lazy ? "-lazy" : "";
+        QTest::newRow(QByteArray("SubTrees" + suffix)) << static_cast<int>(KSelectionProxyModel::SubTrees) << lazy;
+        QTest::newRow(QByteArray("SubTreesWithoutRoots" + suffix)) << static_cast<int>(KSelectionProxyModel::SubTreesWithoutRoots) << lazy;
+        QTest::newRow(QByteArray("ChildrenOfExactSelection" + suffix)) << static_cast<int>(KSelectionProxyModel::ChildrenOfExactSelection) << lazy;
+        QTest::newRow(QByteArray("ExactSelection" + suffix)) << static_cast<int>(KSelectionProxyModel::ExactSelection) << lazy;
+    }
+}
+
+void KSelectionProxyModelTest::sortChildren()
+{
+    QFETCH(int, kspm_mode);
+    QFETCH(bool, lazyParentMappings);
+
+    QStandardItemModel model;
+    auto *itemA = new QStandardItem(QStringLiteral("A"));
+    itemA->appendRows(makeStandardItems({QStringLiteral("A3"), QStringLiteral("A1"), QStringLiteral("A2")}));
+    auto *itemB = new QStandardItem(QStringLiteral("B"));
+    auto *itemB2 = new QStandardItem(QStringLiteral("B2"));
+    itemB2->appendRows(makeStandardItems({QStringLiteral("B2b"), QStringLiteral("B2a")}));
+    itemB->appendRow(itemB2);
+    itemB->appendRow(new QStandardItem(QStringLiteral("B1")));
+    model.appendRow(itemA);
+    model.appendRow(itemB);
+
+    // Sorts the children of item recursively, announcing all sorted parents like a sort filter proxy would.
+    const auto sortChildren = [&model](QStandardItem *item, const QList<QPersistentModelIndex> &parents) {
+        Q_EMIT model.layoutAboutToBeChanged(parents, QAbstractItemModel::VerticalSortHint);
+        {
+            const QSignalBlocker blocker(&model);
+            item->sortChildren(0);
+        }
+        Q_EMIT model.layoutChanged(parents, QAbstractItemModel::VerticalSortHint);
+    };
+
+    QItemSelectionModel selectionModel(&model);
+    selectionModel.select(itemB->index(), QItemSelectionModel::Select);
+    selectionModel.select(itemB2->index(), QItemSelectionModel::Select);
+
+    KSelectionProxyModel proxy(&selectionModel);
+    new ModelTest(&proxy, &proxy);
+    proxy.setFilterBehavior(static_cast<KSelectionProxyModel::FilterBehavior>(kspm_mode));
+    proxy.setLazyParentMappings(lazyParentMappings);
+    proxy.setSourceModel(&model);
+
+    const QString textBefore = treeToText(&proxy);
+
+    QSignalSpy layoutAboutToBeChangedSpy(&proxy, &QAbstractItemModel::layoutAboutToBeChanged);
+    QSignalSpy layoutChangedSpy(&proxy, &QAbstractItemModel::layoutChanged);
+
+    // Sorting a branch without selected items doesn't affect the proxy
+    sortChildren(itemA, {itemA->index()});
+    QCOMPARE(layoutAboutToBeChangedSpy.count(), 0);
+    QCOMPARE(layoutChangedSpy.count(), 0);
+    QCOMPARE(treeToText(&proxy), textBefore);
+
+    QList<QPersistentModelIndex> persistentIndexes;
+    for (const QString &text : {QStringLiteral("B1"), QStringLiteral("B2"), QStringLiteral("B2a"), QStringLiteral("B2b")}) {
+        const QModelIndex sourceIndex = model.match(model.index(0, 0), Qt::DisplayRole, text, 1, Qt::MatchRecursive | Qt::MatchExactly).value(0);
+        persistentIndexes << QPersistentModelIndex(proxy.mapFromSource(sourceIndex));
+    }
+
+    sortChildren(itemB, {itemB->index(), itemB2->index()});
+
+    // The proxy has the same content as a newly created one
+    KSelectionProxyModel reference(&selectionModel);
+    reference.setFilterBehavior(static_cast<KSelectionProxyModel::FilterBehavior>(kspm_mode));
+    reference.setSourceModel(&model);
+    QCOMPARE(treeToText(&proxy), treeToText(&reference));
+
+    for (const QPersistentModelIndex &persistentIndex : std::as_const(persistentIndexes)) {
+        if (persistentIndex.isValid()) {
+            QCOMPARE(proxy.mapToSource(persistentIndex).data().toString(), persistentIndex.data().toString());
+        }
+    }
+}
+
+void KSelectionProxyModelTest::switchFilterBehavior_data()
+{
+    QTest::addColumn<int>("fromMode");
+    QTest::addColumn<int>("toMode");
+    QTest::addColumn<bool>("reset");
+
+    const int subTrees = KSelectionProxyModel::SubTrees;
+    const int subTreeRoots = KSelectionProxyModel::SubTreeRoots;
+    const int exactSelection = KSelectionProxyModel::ExactSelection;
+
+    QTest::newRow("SubTrees-SubTreeRoots") << subTrees << subTreeRoots << false;
+    QTest::newRow("SubTreeRoots-SubTrees") << subTreeRoots << subTrees << false;
+    QTest::newRow("SubTreeRoots-ExactSelection") << subTreeRoots << exactSelection << false;
+    QTest::newRow("ExactSelection-SubTreeRoots") << exactSelection << subTreeRoots << false;
+    QTest::newRow("SubTrees-ExactSelection") << subTrees << exactSelection << false;
+    QTest::newRow("ExactSelection-SubTrees") << exactSelection << subTrees << false;
+    QTest::newRow("SubTrees-SubTreesWithoutRoots") << subTrees << static_cast<int>(KSelectionProxyModel::SubTreesWithoutRoots) << true;
+    QTest::newRow("ExactSelection-ChildrenOfExactSelection") << exactSelection << static_cast<int>(KSelectionProxyModel::ChildrenOfExactSelection) << true;
+}
+
+void KSelectionProxyModelTest::switchFilterBehavior()
+{
+    QFETCH(int, fromMode);
+    QFETCH(int, toMode);
+    QFETCH(bool, reset);
+
+    DynamicTreeModel tree;
+    ModelResetCommand resetCommand(&tree);
+    resetCommand.setInitialTree(
+        " - 1"
+        " - - 2"
+        " - - - 3"
+        " - - - - 4"
+        " - - 5"
+        " - 6"
+        " - - 7"
+        " - 8");
+    resetCommand.doCommand();
+
+    QItemSelectionModel selectionModel(&tree);
+    for (const QString &text : {QStringLiteral("1"), QStringLiteral("3"), QStringLiteral("6"), QStringLiteral("8")}) {
+        const QModelIndex idx = tree.match(tree.index(0, 0), Qt::DisplayRole, text, 1, Qt::MatchRecursive | Qt::MatchExactly).value(0);
+        QVERIFY(idx.isValid());
+        selectionModel.select(idx, QItemSelectionModel::Select);
+    }
+
+    KSelectionProxyModel proxy(&selectionModel);
+    new ModelTest(&proxy, &proxy);
+    proxy.setFilterBehavior(static_cast<KSelectionProxyModel::FilterBehavior>(fromMode));
+    proxy.setSourceModel(&tree);
+    // Create the parent mappings, like a view would
+    treeToText(&proxy);
+
+    const QPersistentModelIndex firstRow = proxy.index(0, 0);
+
+    QSignalSpy resetSpy(&proxy, &QAbstractItemModel::modelReset);
+    QSignalSpy filterBehaviorSpy(&proxy, &KSelectionProxyModel::filterBehaviorChanged);
+
+    proxy.setFilterBehavior(static_cast<KSelectionProxyModel::FilterBehavior>(toMode));
+    QCOMPARE(proxy.filterBehavior(), static_cast<KSelectionProxyModel::FilterBehavior>(toMode));
+    QCOMPARE(filterBehaviorSpy.count(), 1);
+    QCOMPARE(resetSpy.count(), reset ? 1 : 0);
+
+    // The proxy has the same content as a newly created one
+    KSelectionProxyModel reference(&selectionModel);
+    reference.setFilterBehavior(static_cast<KSelectionProxyModel::FilterBehavior>(toMode));
+    reference.setSourceModel(&tree);
+    QCOMPARE(treeToText(&proxy), treeToText(&reference));
+
+    if (!reset) {
+        // Roots which are shown before and after are kept
+        QVERIFY(firstRow.isValid());
+        QCOMPARE(firstRow.data().toString(), QStringLiteral("1"));
+    }
+}
+
 void KSelectionProxyModelTest::selectionMapping()
 {
     QStringListModel strings(days);
@@ -618,6 +895,65 @@ void KSelectionProxyModelTest::selectionMapping()
     QCOMPARE(proxy.mapSelectionToSource(proxySel), sourceSel);
 }
 
+void KSelectionProxyModelTest::selectionRangeMapping_data()
+{
+    QTest::addColumn<int>("kspm_mode");
+
+    QTest::newRow("SubTrees") << static_cast<int>(KSelectionProxyModel::SubTrees);
+    QTest::newRow("SubTreeRoots") << static_cast<int>(KSelectionProxyModel::SubTreeRoots);
+    QTest::newRow("ExactSelection") << static_cast<int>(KSelectionProxyModel::ExactSelection);
+}
+
+void KSelectionProxyModelTest::selectionRangeMapping()
+{
+    QFETCH(int, kspm_mode);
+
+    QStringList numbers;
+    for (int i = 0; i < 10; ++i) {
+        numbers << QString::number(i);
+    }
+    QStringListModel strings(numbers);
+    QItemSelectionModel selectionModel(&strings);
+    KSelectionProxyModel proxy(&selectionModel);
+    proxy.setFilterBehavior(static_cast<KSelectionProxyModel::FilterBehavior>(kspm_mode));
+    proxy.setSourceModel(&strings);
+
+    const QItemSelectionRange firstRoots(strings.index(0, 0), strings.index(3, 0));
+    const QItemSelectionRange secondRoots(strings.index(5, 0), strings.index(6, 0));
+    QItemSelection sourceSel;
+    sourceSel << firstRoots << secondRoots;
+    selectionModel.select(sourceSel, QItemSelectionModel::Select);
+    QCOMPARE(proxy.rowCount(), 6);
+
+    // A contiguous proxy range is split where the roots are not contiguous in the source.
+    QItemSelection proxySel;
+    proxySel << QItemSelectionRange(proxy.index(0, 0), proxy.index(5, 0));
+    QCOMPARE(proxy.mapSelectionToSource(proxySel), sourceSel);
+
+    // Source rows which are not roots are skipped, and the remaining rows are merged.
+    QItemSelection allSource;
+    allSource << QItemSelectionRange(strings.index(0, 0), strings.index(9, 0));
+    QCOMPARE(proxy.mapSelectionFromSource(allSource), proxySel);
+
+    // Adjacent ranges are merged in both directions.
+    QItemSelection adjacentSource;
+    adjacentSource << QItemSelectionRange(strings.index(0, 0), strings.index(1, 0)) << QItemSelectionRange(strings.index(2, 0), strings.index(3, 0));
+    QItemSelection expectedProxy;
+    expectedProxy << QItemSelectionRange(proxy.index(0, 0), proxy.index(3, 0));
+    QCOMPARE(proxy.mapSelectionFromSource(adjacentSource), expectedProxy);
+
+    QItemSelection adjacentProxy;
+    adjacentProxy << QItemSelectionRange(proxy.index(0, 0), proxy.index(1, 0)) << QItemSelectionRange(proxy.index(2, 0), proxy.index(3, 0));
+    QItemSelection expectedSource;
+    expectedSource << firstRoots;
+    QCOMPARE(proxy.mapSelectionToSource(adjacentProxy), expectedSource);
+
+    // Unselected source rows map to nothing.
+    QItemSelection unselected;
+    unselected << QItemSelectionRange(strings.index(4, 0), strings.index(4, 0)) << QItemSelectionRange(strings.index(7, 0), strings.index(9, 0));
+    QVERIFY(proxy.mapSelectionFromSource(unselected).isEmpty());
+}
+
 QTEST_MAIN(KSelectionProxyModelTest)
 
 #include "kselectionproxymodeltest.moc"
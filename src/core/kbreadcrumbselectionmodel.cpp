@@ -7,6 +7,9 @@
 
 #include "kbreadcrumbselectionmodel.h"
 
+#include <QHash>
+#include <QSet>
+
 class KBreadcrumbSelectionModelPrivate
 {
     Q_DECLARE_PUBLIC(KBreadcrumbSelectionModel)
@@ -27,10 +30,44 @@ public:
     */
     QItemSelection getBreadcrumbSelection(const QItemSelection &selection);
 
+    /*
+      Calls func with each breadcrumb ancestor of range, up to the breadcrumb length, starting with its parent.
+    */
+    template<typename Func>
+    void forEachBreadcrumbAncestor(const QItemSelectionRange &range, Func func) const;
+
+    /*
+      Adds the ancestors of the indexes in selection to m_breadcrumbRefCounts,
+      and returns the ancestors which were not breadcrumbs before.
+    */
+    QItemSelection addBreadcrumbAncestors(const QItemSelection &selection);
+
+    /*
+      Removes the ancestors of the indexes in selection from m_breadcrumbRefCounts,
+      and returns the ancestors which are not breadcrumbs any more.
+    */
+    QItemSelection removeBreadcrumbAncestors(const QItemSelection &selection);
+
+    /*
+      Returns the ranges of deselected without the indexes which are still breadcrumbs.
+    */
+    QItemSelection withoutBreadcrumbs(const QItemSelection &deselected) const;
+
     void sourceSelectionChanged(const QItemSelection &selected, const QItemSelection &deselected);
 
+    /*
+      Returns whether one of the selected indexes is one of the rows from start to end in parent, or a descendant of them.
+    */
+    bool selectionIntersectsSubtrees(const QModelIndex &parent, int start, int end) const;
+
     void syncBreadcrumbs();
 
+    // For each breadcrumb ancestor, the number of selected indexes it is an ancestor of.
+    // The keys are persistent so that they follow the rows when the model changes; their
+    // hash doesn't change with them. The selected indexes of removed rows are deselected
+    // first, so the counts of removed ancestors drop to zero and are erased before.
+    QHash<QPersistentModelIndex, int> m_breadcrumbRefCounts;
+
     bool m_includeActualSelection = true;
     bool m_showHiddenAscendantData = false;
     bool m_ignoreCurrentChanged = false;
@@ -54,17 +91,30 @@ KBreadcrumbSelectionModelPrivate::KBreadcrumbSelectionModelPrivate(KBreadcrumbSe
         });
     }
 
-    q->connect(m_selectionModel->model(), &QAbstractItemModel::layoutChanged, q, [this]() {
-        syncBreadcrumbs();
-    });
+    q->connect(m_selectionModel->model(),
+               &QAbstractItemModel::layoutChanged,
+               q,
+               [this](const QList<QPersistentModelIndex> &, QAbstractItemModel::LayoutChangeHint hint) {
+                   // Sorting doesn't change the ancestors of any index.
+                   if (hint != QAbstractItemModel::VerticalSortHint && hint != QAbstractItemModel::HorizontalSortHint) {
+                       syncBreadcrumbs();
+                   }
+               });
     q->connect(m_selectionModel->model(), &QAbstractItemModel::modelReset, q, [this]() {
-        syncBreadcrumbs();
-    });
-    q->connect(m_selectionModel->model(), &QAbstractItemModel::rowsMoved, q, [this]() {
-        syncBreadcrumbs();
+        // Both selection models are cleared by the reset already.
+        m_breadcrumbRefCounts.clear();
     });
-
-    // Don't need to handle insert & remove because they can't change the breadcrumbs on their own.
+    q->connect(m_selectionModel->model(),
+               &QAbstractItemModel::rowsMoved,
+               q,
+               [this](const QModelIndex &, int start, int end, const QModelIndex &destination, int row) {
+                   // Only the moved subtrees get new ancestors.
+                   if (selectionIntersectsSubtrees(destination, row, row + end - start)) {
+                       syncBreadcrumbs();
+                   }
+               });
+    // Insertions & removals can't change the breadcrumbs on their own: the removed selected
+    // indexes are deselected first, and the persistent breadcrumbs follow the other rows.
 }
 
 KBreadcrumbSelectionModel::KBreadcrumbSelectionModel(QItemSelectionModel *selectionModel, QObject *parent)
@@ -102,7 +152,14 @@ int KBreadcrumbSelectionModel::breadcrumbLength() const
 void KBreadcrumbSelectionModel::setBreadcrumbLength(int breadcrumbLength)
 {
     Q_D(KBreadcrumbSelectionModel);
+    if (breadcrumbLength == d->m_selectionDepth) {
+        return;
+    }
     d->m_selectionDepth = breadcrumbLength;
+    if (d->m_direction != MakeBreadcrumbSelectionInSelf) {
+        // The ancestors beyond the new length aren't breadcrumbs any more, or new ones are
+        d->syncBreadcrumbs();
+    }
 }
 
 QItemSelection KBreadcrumbSelectionModelPrivate::getBreadcrumbSelection(const QModelIndex &index)
@@ -131,47 +188,88 @@ QItemSelection KBreadcrumbSelectionModelPrivate::getBreadcrumbSelection(const QI
         breadcrumbSelection = selection;
     }
 
-    QItemSelection::const_iterator it = selection.constBegin();
-    const QItemSelection::const_iterator end = selection.constEnd();
-
-    for (; it != end; ++it) {
-        QModelIndex parent = it->parent();
+    QSet<QModelIndex> breadcrumbAncestors;
+    for (const QItemSelectionRange &range : selection) {
+        forEachBreadcrumbAncestor(range, [&](const QModelIndex &ancestor) {
+            if (breadcrumbAncestors.contains(ancestor)) {
+                // Its ancestors are in the selection already
+                return false;
+            }
+            breadcrumbAncestors.insert(ancestor);
+            breadcrumbSelection.append(QItemSelectionRange(ancestor));
+            return true;
+        });
+    }
+    return breadcrumbSelection;
+}
 
-        if (breadcrumbSelection.contains(parent)) {
-            continue;
+template<typename Func>
+void KBreadcrumbSelectionModelPrivate::forEachBreadcrumbAncestor(const QItemSelectionRange &range, Func func) const
+{
+    QModelIndex parent = range.parent();
+    int sumBreadcrumbs = 0;
+    const bool includeAll = m_selectionDepth < 0;
+    while (parent.isValid() && (includeAll || sumBreadcrumbs < m_selectionDepth)) {
+        if (!func(parent)) {
+            return;
         }
+        parent = parent.parent();
+        ++sumBreadcrumbs;
+    }
+}
 
-        int sumBreadcrumbs = 0;
-        bool includeAll = m_selectionDepth < 0;
-
-        while (parent.isValid() && (includeAll || sumBreadcrumbs < m_selectionDepth)) {
-            breadcrumbSelection.append(QItemSelectionRange(parent));
-            parent = parent.parent();
-
-            if (breadcrumbSelection.contains(parent)) {
-                break;
+QItemSelection KBreadcrumbSelectionModelPrivate::addBreadcrumbAncestors(const QItemSelection &selection)
+{
+    QItemSelection added;
+    for (const QItemSelectionRange &range : selection) {
+        const int count = range.height() * range.width();
+        forEachBreadcrumbAncestor(range, [&](const QModelIndex &ancestor) {
+            int &refCount = m_breadcrumbRefCounts[ancestor];
+            if (refCount == 0) {
+                added.append(QItemSelectionRange(ancestor));
             }
+            refCount += count;
+            return true;
+        });
+    }
+    return added;
+}
 
-            ++sumBreadcrumbs;
-        }
+QItemSelection KBreadcrumbSelectionModelPrivate::removeBreadcrumbAncestors(const QItemSelection &selection)
+{
+    QItemSelection removed;
+    for (const QItemSelectionRange &range : selection) {
+        const int count = range.height() * range.width();
+        forEachBreadcrumbAncestor(range, [&](const QModelIndex &ancestor) {
+            const auto it = m_breadcrumbRefCounts.find(ancestor);
+            if (it == m_breadcrumbRefCounts.end()) {
+                return true;
+            }
+            it.value() -= count;
+            if (it.value() <= 0) {
+                m_breadcrumbRefCounts.erase(it);
+                // It can be selected on its own too
+                if (!m_includeActualSelection || !m_selectionModel->isSelected(ancestor)) {
+                    removed.append(QItemSelectionRange(ancestor));
+                }
+            }
+            return true;
+        });
     }
-    return breadcrumbSelection;
+    return removed;
 }
 
 void KBreadcrumbSelectionModelPrivate::sourceSelectionChanged(const QItemSelection &selected, const QItemSelection &deselected)
 {
     Q_Q(KBreadcrumbSelectionModel);
-    const QItemSelection deselectedCrumbs = getBreadcrumbSelection(deselected);
-    const QItemSelection selectedCrumbs = getBreadcrumbSelection(selected);
 
-    QItemSelection removed = deselectedCrumbs;
-    for (const QItemSelectionRange &range : selectedCrumbs) {
-        removed.removeAll(range);
-    }
+    // Ancestors shared with indexes which stay selected are neither deselected nor selected again.
+    QItemSelection added = addBreadcrumbAncestors(selected);
+    QItemSelection removed = removeBreadcrumbAncestors(deselected);
 
-    QItemSelection added = selectedCrumbs;
-    for (const QItemSelectionRange &range : deselectedCrumbs) {
-        added.removeAll(range);
+    if (m_includeActualSelection) {
+        added += selected;
+        removed += withoutBreadcrumbs(deselected);
     }
 
     if (!removed.isEmpty()) {
@@ -182,6 +280,62 @@ void KBreadcrumbSelectionModelPrivate::sourceSelectionChanged(const QItemSelecti
     }
 }
 
+QItemSelection KBreadcrumbSelectionModelPrivate::withoutBreadcrumbs(const QItemSelection &deselected) const
+{
+    if (m_breadcrumbRefCounts.isEmpty()) {
+        return deselected;
+    }
+    QItemSelection result;
+    for (const QItemSelectionRange &range : deselected) {
+        // Look for the breadcrumbs in the range, from whichever is the smallest
+        QSet<QModelIndex> breadcrumbs;
+        if (m_breadcrumbRefCounts.size() < range.height() * range.width()) {
+            for (auto it = m_breadcrumbRefCounts.cbegin(); it != m_breadcrumbRefCounts.cend(); ++it) {
+                if (range.contains(it.key())) {
+                    breadcrumbs.insert(it.key());
+                }
+            }
+        } else {
+            const QModelIndexList indexes = range.indexes();
+            for (const QModelIndex &index : indexes) {
+                if (m_breadcrumbRefCounts.contains(index)) {
+                    breadcrumbs.insert(index);
+                }
+            }
+        }
+        if (breadcrumbs.isEmpty()) {
+            result.append(range);
+            continue;
+        }
+        const QModelIndexList indexes = range.indexes();
+        for (const QModelIndex &index : indexes) {
+            if (!breadcrumbs.contains(index)) {
+                result.append(QItemSelectionRange(index));
+            }
+        }
+    }
+    return result;
+}
+
+bool KBreadcrumbSelectionModelPrivate::selectionIntersectsSubtrees(const QModelIndex &parent, int start, int end) const
+{
+    const QItemSelection selection = m_selectionModel->selection();
+    for (const QItemSelectionRange &range : selection) {
+        QModelIndex index = range.topLeft();
+        while (index.isValid()) {
+            if (index.parent() == parent && index.row() >= start && index.row() <= end) {
+                return true;
+            }
+            index = index.parent();
+        }
+        // A range can also start before the subtrees and contain them
+        if (range.parent() == parent && range.top() <= end && range.bottom() >= start) {
+            return true;
+        }
+    }
+    return false;
+}
+
 void KBreadcrumbSelectionModel::select(const QModelIndex &index, QItemSelectionModel::SelectionFlags command)
 {
     Q_D(KBreadcrumbSelectionModel);
@@ -216,7 +370,18 @@ void KBreadcrumbSelectionModel::select(const QItemSelection &selection, QItemSel
 void KBreadcrumbSelectionModelPrivate::syncBreadcrumbs()
 {
     Q_Q(KBreadcrumbSelectionModel);
-    q->select(m_selectionModel->selection(), QItemSelectionModel::ClearAndSelect);
+    const QItemSelection selection = m_selectionModel->selection();
+    if (m_direction == KBreadcrumbSelectionModel::MakeBreadcrumbSelectionInSelf) {
+        q->select(selection, QItemSelectionModel::ClearAndSelect);
+        return;
+    }
+    // Only this selection model changes, so the counts can't be updated by the linked one meanwhile
+    m_breadcrumbRefCounts.clear();
+    QItemSelection breadcrumbs = addBreadcrumbAncestors(selection);
+    if (m_includeActualSelection) {
+        breadcrumbs += selection;
+    }
+    q->QItemSelectionModel::select(breadcrumbs, QItemSelectionModel::ClearAndSelect);
 }
 
 #include "moc_kbreadcrumbselectionmodel.cpp"
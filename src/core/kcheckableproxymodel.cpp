@@ -6,7 +6,12 @@
 
 #include "kcheckableproxymodel.h"
 
+#include <QHash>
 #include <QItemSelectionModel>
+#include <QSet>
+
+#include <algorithm>
+#include <utility>
 
 class KCheckableProxyModelPrivate
 {
@@ -19,10 +24,132 @@ class KCheckableProxyModelPrivate
     }
 
     QItemSelectionModel *m_itemSelectionModel = nullptr;
+    QMetaObject::Connection m_selectionChangedConnection;
+    QMetaObject::Connection m_selectionModelChangedConnection;
+    QList<QMetaObject::Connection> m_sourceModelConnections;
+
+    // The checked rows of each source parent, that is, the rows whose column 0 is
+    // selected. Built lazily from the selection, kept up to date from the selectionChanged
+    // deltas and dropped whenever the structure of the source model changes, as the keys
+    // are plain model indexes.
+    mutable QHash<QModelIndex, QSet<int>> m_checkedRows;
+    mutable bool m_checkedRowsValid = false;
+
+    // In tristate mode, the number of checked descendants of every source index which
+    // has any, maintained together with m_checkedRows.
+    bool m_tristate = false;
+    mutable QHash<QModelIndex, int> m_checkedDescendants;
 
+    // The check states of the ancestors of rows about to be removed or moved, so that
+    // those which change can be notified afterwards.
+    QList<std::pair<QPersistentModelIndex, Qt::CheckState>> m_savedAncestorStates;
+
+    void ensureCheckedRows() const;
+    void invalidateCheckedRows();
+    bool isChecked(const QModelIndex &sourceIndex) const;
+    Qt::CheckState checkState(const QModelIndex &sourceIndex) const;
+    void addCheckedDescendants(const QModelIndex &sourceParent, int count, QItemSelection *changedAncestors) const;
+    void saveAncestorStates(const QModelIndex &sourceParent);
+    void emitChangedAncestorStates();
+
+    void emitCheckStateChanged(const QItemSelection &sourceSelection);
     void selectionChanged(const QItemSelection &selected, const QItemSelection &deselected);
 };
 
+void KCheckableProxyModelPrivate::ensureCheckedRows() const
+{
+    if (m_checkedRowsValid) {
+        return;
+    }
+    m_checkedRowsValid = true;
+    const QItemSelection selection = m_itemSelectionModel->selection();
+    for (const QItemSelectionRange &range : selection) {
+        if (!range.isValid() || range.left() > 0) {
+            continue;
+        }
+        QSet<int> &rows = m_checkedRows[range.parent()];
+        int added = 0;
+        for (int row = range.top(); row <= range.bottom(); ++row) {
+            if (!rows.contains(row)) {
+                rows.insert(row);
+                ++added;
+            }
+        }
+        if (m_tristate) {
+            addCheckedDescendants(range.parent(), added, nullptr);
+        }
+    }
+}
+
+void KCheckableProxyModelPrivate::invalidateCheckedRows()
+{
+    m_checkedRows.clear();
+    m_checkedDescendants.clear();
+    m_checkedRowsValid = false;
+}
+
+bool KCheckableProxyModelPrivate::isChecked(const QModelIndex &sourceIndex) const
+{
+    ensureCheckedRows();
+    const auto it = m_checkedRows.constFind(sourceIndex.parent());
+    return it != m_checkedRows.constEnd() && it->contains(sourceIndex.row());
+}
+
+Qt::CheckState KCheckableProxyModelPrivate::checkState(const QModelIndex &sourceIndex) const
+{
+    if (isChecked(sourceIndex)) {
+        return Qt::Checked;
+    }
+    if (m_tristate && m_checkedDescendants.value(sourceIndex) > 0) {
+        return Qt::PartiallyChecked;
+    }
+    return Qt::Unchecked;
+}
+
+void KCheckableProxyModelPrivate::addCheckedDescendants(const QModelIndex &sourceParent, int count, QItemSelection *changedAncestors) const
+{
+    if (count == 0) {
+        return;
+    }
+    for (QModelIndex ancestor = sourceParent; ancestor.isValid(); ancestor = ancestor.parent()) {
+        auto it = m_checkedDescendants.find(ancestor);
+        const bool hadCheckedDescendants = it != m_checkedDescendants.end();
+        if (!hadCheckedDescendants) {
+            it = m_checkedDescendants.insert(ancestor, 0);
+        }
+        *it += count;
+        const bool hasCheckedDescendants = *it > 0;
+        if (!hasCheckedDescendants) {
+            m_checkedDescendants.erase(it);
+        }
+        if (changedAncestors && hadCheckedDescendants != hasCheckedDescendants && !isChecked(ancestor)) {
+            changedAncestors->select(ancestor, ancestor);
+        }
+    }
+}
+
+void KCheckableProxyModelPrivate::saveAncestorStates(const QModelIndex &sourceParent)
+{
+    if (!m_tristate || !m_itemSelectionModel) {
+        return;
+    }
+    for (QModelIndex ancestor = sourceParent; ancestor.isValid(); ancestor = ancestor.parent()) {
+        m_savedAncestorStates.append({QPersistentModelIndex(ancestor), checkState(ancestor)});
+    }
+}
+
+void KCheckableProxyModelPrivate::emitChangedAncestorStates()
+{
+    QItemSelection changedAncestors;
+    const auto savedAncestorStates = std::exchange(m_savedAncestorStates, {});
+    for (const auto &[ancestor, state] : savedAncestorStates) {
+        if (ancestor.isValid() && checkState(ancestor) != state) {
+            changedAncestors.select(ancestor, ancestor);
+        }
+    }
+    emitCheckStateChanged(changedAncestors);
+}
+
 KCheckableProxyModel::KCheckableProxyModel(QObject *parent)
     : QIdentityProxyModel(parent)
     , d_ptr(new KCheckableProxyModelPrivate(this))
@@ -34,10 +161,19 @@ KCheckableProxyModel::~KCheckableProxyModel() = default;
 void KCheckableProxyModel::setSelectionModel(QItemSelectionModel *itemSelectionModel)
 {
     Q_D(KCheckableProxyModel);
+    disconnect(d->m_selectionChangedConnection);
+    disconnect(d->m_selectionModelChangedConnection);
+    d->invalidateCheckedRows();
     d->m_itemSelectionModel = itemSelectionModel;
     Q_ASSERT(sourceModel() ? d->m_itemSelectionModel->model() == sourceModel() : true);
-    connect(itemSelectionModel, &QItemSelectionModel::selectionChanged, this, [d](const QItemSelection &selected, const QItemSelection &deselected) {
-        d->selectionChanged(selected, deselected);
+    d->m_selectionChangedConnection = connect(itemSelectionModel,
+                                              &QItemSelectionModel::selectionChanged,
+                                              this,
+                                              [d](const QItemSelection &selected, const QItemSelection &deselected) {
+                                                  d->selectionChanged(selected, deselected);
+                                              });
+    d->m_selectionModelChangedConnection = connect(itemSelectionModel, &QItemSelectionModel::modelChanged, this, [d] {
+        d->invalidateCheckedRows();
     });
 }
 
@@ -67,7 +203,7 @@ QVariant KCheckableProxyModel::data(const QModelIndex &index, int role) const
             return Qt::Unchecked;
         }
 
-        return d->m_itemSelectionModel->selection().contains(mapToSource(index)) ? Qt::Checked : Qt::Unchecked;
+        return d->checkState(mapToSource(index));
     }
     return QIdentityProxyModel::data(index, role);
 }
@@ -86,7 +222,7 @@ bool KCheckableProxyModel::setData(const QModelIndex &index, const QVariant &val
         Qt::CheckState state = static_cast<Qt::CheckState>(value.toInt());
         const QModelIndex srcIndex = mapToSource(index);
         bool result = select(QItemSelection(srcIndex, srcIndex), state == Qt::Checked ? QItemSelectionModel::Select : QItemSelectionModel::Deselect);
-        Q_EMIT dataChanged(index, index);
+        Q_EMIT dataChanged(index, index, {Qt::CheckStateRole});
         return result;
     }
     return QIdentityProxyModel::setData(index, value, role);
@@ -94,21 +230,212 @@ bool KCheckableProxyModel::setData(const QModelIndex &index, const QVariant &val
 
 void KCheckableProxyModel::setSourceModel(QAbstractItemModel *sourceModel)
 {
+    Q_D(KCheckableProxyModel);
+    for (const QMetaObject::Connection &connection : std::as_const(d->m_sourceModelConnections)) {
+        disconnect(connection);
+    }
+    d->m_sourceModelConnections.clear();
+    d->invalidateCheckedRows();
+
+    if (sourceModel) {
+        // Connected before QIdentityProxyModel forwards the structural changes, so that the
+        // check states are up to date when the users of the proxy react to them
+        const auto invalidate = [d] {
+            d->invalidateCheckedRows();
+        };
+        d->m_sourceModelConnections = {
+            connect(sourceModel, &QAbstractItemModel::rowsInserted, this, invalidate),
+            connect(sourceModel, &QAbstractItemModel::rowsRemoved, this, invalidate),
+            connect(sourceModel, &QAbstractItemModel::rowsMoved, this, invalidate),
+            connect(sourceModel, &QAbstractItemModel::columnsInserted, this, invalidate),
+            connect(sourceModel, &QAbstractItemModel::columnsRemoved, this, invalidate),
+            connect(sourceModel, &QAbstractItemModel::columnsMoved, this, invalidate),
+            connect(sourceModel, &QAbstractItemModel::layoutChanged, this, invalidate),
+            connect(sourceModel, &QAbstractItemModel::modelReset, this, invalidate),
+        };
+    }
+
     QIdentityProxyModel::setSourceModel(sourceModel);
     Q_ASSERT(d_ptr->m_itemSelectionModel ? d_ptr->m_itemSelectionModel->model() == sourceModel : true);
+
+    if (!sourceModel) {
+        return;
+    }
+    // The ancestors are notified once the proxy forwarded the removal or the move
+    const auto emitChangedAncestorStates = [d] {
+        d->emitChangedAncestorStates();
+    };
+    d->m_sourceModelConnections += {
+        connect(sourceModel,
+                &QAbstractItemModel::rowsAboutToBeRemoved,
+                this,
+                [d](const QModelIndex &parent) {
+                    d->saveAncestorStates(parent);
+                }),
+        connect(sourceModel,
+                &QAbstractItemModel::rowsAboutToBeMoved,
+                this,
+                [d](const QModelIndex &sourceParent, int, int, const QModelIndex &destinationParent) {
+                    d->saveAncestorStates(sourceParent);
+                    d->saveAncestorStates(destinationParent);
+                }),
+        connect(sourceModel, &QAbstractItemModel::rowsRemoved, this, emitChangedAncestorStates),
+        connect(sourceModel, &QAbstractItemModel::rowsMoved, this, emitChangedAncestorStates),
+    };
 }
 
 void KCheckableProxyModelPrivate::selectionChanged(const QItemSelection &selected, const QItemSelection &deselected)
+{
+    QItemSelection changed = selected;
+    changed += deselected;
+
+    if (m_checkedRowsValid) {
+        // Only ancestors which gain their first or lose their last checked descendant change
+        for (const QItemSelectionRange &range : selected) {
+            if (!range.isValid() || range.left() > 0) {
+                continue;
+            }
+            QSet<int> &rows = m_checkedRows[range.parent()];
+            int added = 0;
+            for (int row = range.top(); row <= range.bottom(); ++row) {
+                if (!rows.contains(row)) {
+                    rows.insert(row);
+                    ++added;
+                }
+            }
+            if (m_tristate) {
+                addCheckedDescendants(range.parent(), added, &changed);
+            }
+        }
+        for (const QItemSelectionRange &range : deselected) {
+            if (!range.isValid() || range.left() > 0) {
+                continue;
+            }
+            const auto it = m_checkedRows.find(range.parent());
+            if (it == m_checkedRows.end()) {
+                continue;
+            }
+            int removed = 0;
+            for (int row = range.top(); row <= range.bottom(); ++row) {
+                removed += it->remove(row) ? 1 : 0;
+            }
+            if (it->isEmpty()) {
+                m_checkedRows.erase(it);
+            }
+            if (m_tristate) {
+                addCheckedDescendants(range.parent(), -removed, &changed);
+            }
+        }
+    } else if (m_tristate) {
+        // Nothing to compare with, notify all the ancestors of the changed rows
+        const QItemSelection ranges = changed;
+        for (const QItemSelectionRange &range : ranges) {
+            if (!range.isValid() || range.left() > 0) {
+                continue;
+            }
+            for (QModelIndex ancestor = range.parent(); ancestor.isValid(); ancestor = ancestor.parent()) {
+                changed.select(ancestor, ancestor);
+            }
+        }
+    }
+
+    emitCheckStateChanged(changed);
+}
+
+void KCheckableProxyModel::setTristate(bool tristate)
+{
+    Q_D(KCheckableProxyModel);
+    if (d->m_tristate == tristate) {
+        return;
+    }
+
+    // The items with checked descendants are the ones whose state changes
+    d->m_tristate = true;
+    d->invalidateCheckedRows();
+    QItemSelection changed;
+    if (d->m_itemSelectionModel && sourceModel()) {
+        d->ensureCheckedRows();
+        for (auto it = d->m_checkedDescendants.cbegin(); it != d->m_checkedDescendants.cend(); ++it) {
+            changed.select(it.key(), it.key());
+        }
+    }
+    d->m_tristate = tristate;
+    if (!tristate) {
+        d->invalidateCheckedRows();
+    }
+    d->emitCheckStateChanged(changed);
+}
+
+bool KCheckableProxyModel::isTristate() const
+{
+    Q_D(const KCheckableProxyModel);
+    return d->m_tristate;
+}
+
+void KCheckableProxyModelPrivate::emitCheckStateChanged(const QItemSelection &sourceSelection)
 {
     Q_Q(KCheckableProxyModel);
-    const auto lstSelected = q->mapSelectionFromSource(selected);
-    for (const QItemSelectionRange &range : lstSelected) {
-        Q_EMIT q->dataChanged(range.topLeft(), range.bottomRight());
+    QAbstractItemModel *const sourceModel = q->sourceModel();
+    if (!sourceModel) {
+        return;
+    }
+
+    // Only the first column is checkable, so only its rows are reported, with one
+    // dataChanged per contiguous span of rows under each parent.
+    QHash<QModelIndex, QList<std::pair<int, int>>> spans;
+    for (const QItemSelectionRange &range : sourceSelection) {
+        if (range.isValid() && range.left() == 0) {
+            spans[range.parent()].append({range.top(), range.bottom()});
+        }
+    }
+
+    const QList<int> roles{Qt::CheckStateRole};
+    for (auto it = spans.begin(); it != spans.end(); ++it) {
+        QList<std::pair<int, int>> &parentSpans = it.value();
+        std::sort(parentSpans.begin(), parentSpans.end());
+        auto span = parentSpans.cbegin();
+        while (span != parentSpans.cend()) {
+            const int top = span->first;
+            int bottom = span->second;
+            for (++span; span != parentSpans.cend() && span->first <= bottom + 1; ++span) {
+                bottom = std::max(bottom, span->second);
+            }
+            Q_EMIT q->dataChanged(q->mapFromSource(sourceModel->index(top, 0, it.key())),
+                                  q->mapFromSource(sourceModel->index(bottom, 0, it.key())),
+                                  roles);
+        }
+    }
+}
+
+void KCheckableProxyModel::setCheckState(const QItemSelection &selection, Qt::CheckState state)
+{
+    Q_D(KCheckableProxyModel);
+    if (!d->m_itemSelectionModel) {
+        return;
     }
-    const auto lstDeselected = q->mapSelectionFromSource(deselected);
-    for (const QItemSelectionRange &range : lstDeselected) {
-        Q_EMIT q->dataChanged(range.topLeft(), range.bottomRight());
+
+    QItemSelection sourceSelection;
+    for (const QItemSelectionRange &range : selection) {
+        if (!range.isValid() || range.left() > 0) {
+            continue;
+        }
+        const QModelIndex top = mapToSource(index(range.top(), 0, range.parent()));
+        const QModelIndex bottom = mapToSource(index(range.bottom(), 0, range.parent()));
+        sourceSelection.append(QItemSelectionRange(top, bottom));
+    }
+    if (sourceSelection.isEmpty()) {
+        return;
+    }
+    select(sourceSelection, state == Qt::Checked ? QItemSelectionModel::Select : QItemSelectionModel::Deselect);
+}
+
+void KCheckableProxyModel::setChildrenCheckState(const QModelIndex &parent, Qt::CheckState state)
+{
+    const int rowCount = this->rowCount(parent);
+    if (rowCount == 0) {
+        return;
     }
+    setCheckState(QItemSelection(index(0, 0, parent), index(rowCount - 1, 0, parent)), state);
 }
 
 bool KCheckableProxyModel::select(const QItemSelection &selection, QItemSelectionModel::SelectionFlags command)
@@ -72,6 +72,51 @@ public:
      */
     QItemSelectionModel *selectionModel() const;
 
+    /*!
+     * Sets the check state of the items of the first column in \a selection, which
+     * refers to indexes of this model, with a single update of the selection model.
+     *
+     * Qt::Checked selects the items, any other \a state deselects them. Views are
+     * notified with one dataChanged() signal for Qt::CheckStateRole per contiguous
+     * range of rows.
+     *
+     * \sa setChildrenCheckState()
+     * \since 6.30
+     */
+    void setCheckState(const QItemSelection &selection, Qt::CheckState state);
+
+    /*!
+     * Sets the check state of all the children of \a parent, for example to check
+     * all items of a list with an invalid \a parent.
+     *
+     * \sa setCheckState()
+     * \since 6.30
+     */
+    void setChildrenCheckState(const QModelIndex &parent, Qt::CheckState state);
+
+    /*!
+     * Sets whether unchecked items with checked descendants are reported as
+     * Qt::PartiallyChecked.
+     *
+     * Whether an item itself is checked still only depends on the selection model;
+     * checking an item does not check its descendants. The number of checked
+     * descendants of each item is maintained incrementally, so the check state of
+     * a parent is available without visiting its subtree.
+     *
+     * The default is \c false.
+     *
+     * \since 6.30
+     */
+    void setTristate(bool tristate);
+
+    /*!
+     * Returns whether partially checked items are reported.
+     *
+     * \sa setTristate()
+     * \since 6.30
+     */
+    bool isTristate() const;
+
     Qt::ItemFlags flags(const QModelIndex &index) const override;
 
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
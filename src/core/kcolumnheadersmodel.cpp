@@ -6,14 +6,40 @@
 
 #include "kcolumnheadersmodel.h"
 
+#include <algorithm>
+
 class KColumnHeadersModelPrivate
 {
 public:
+    void updateRoleNames();
+    void clearHeaders(int first, int last);
+
     QAbstractItemModel *sourceModel = nullptr;
     int sortColumn = -1;
     Qt::SortOrder sortOrder = Qt::AscendingOrder;
+
+    // The role names of the source model, with SortRole
+    QHash<int, QByteArray> roleNames;
+    // The header data fetched from the source model, per section and role
+    mutable QList<QHash<int, QVariant>> headers;
 };
 
+void KColumnHeadersModelPrivate::updateRoleNames()
+{
+    roleNames.clear();
+    if (sourceModel) {
+        roleNames = sourceModel->roleNames();
+        roleNames.insert(KColumnHeadersModel::SortRole, "sort");
+    }
+}
+
+void KColumnHeadersModelPrivate::clearHeaders(int first, int last)
+{
+    for (int section = std::max(first, 0); section <= last && section < headers.size(); ++section) {
+        headers[section].clear();
+    }
+}
+
 KColumnHeadersModel::KColumnHeadersModel(QObject *parent)
     : QAbstractListModel(parent)
     , d(new KColumnHeadersModelPrivate)
@@ -47,18 +73,23 @@ QVariant KColumnHeadersModel::data(const QModelIndex &index, int role) const
         }
     }
 
-    return sourceModel()->headerData(index.row(), Qt::Horizontal, role);
+    if (index.row() >= d->headers.size()) {
+        d->headers.resize(rowCount());
+        if (index.row() >= d->headers.size()) {
+            return sourceModel()->headerData(index.row(), Qt::Horizontal, role);
+        }
+    }
+    QHash<int, QVariant> &sectionHeaders = d->headers[index.row()];
+    auto it = sectionHeaders.constFind(role);
+    if (it == sectionHeaders.constEnd()) {
+        it = sectionHeaders.insert(role, sourceModel()->headerData(index.row(), Qt::Horizontal, role));
+    }
+    return *it;
 }
 
 QHash<int, QByteArray> KColumnHeadersModel::roleNames() const
 {
-    if (!d->sourceModel) {
-        return QHash<int, QByteArray>{};
-    }
-
-    auto names = d->sourceModel->roleNames();
-    names.insert(SortRole, "sort");
-    return names;
+    return d->roleNames;
 }
 
 QAbstractItemModel *KColumnHeadersModel::sourceModel() const
@@ -78,13 +109,17 @@ void KColumnHeadersModel::setSourceModel(QAbstractItemModel *newSourceModel)
 
     beginResetModel();
     d->sourceModel = newSourceModel;
+    d->headers.clear();
+    d->updateRoleNames();
     endResetModel();
 
+    // The cached headers are updated before the changes are forwarded
     if (newSourceModel) {
         connect(newSourceModel, &QAbstractItemModel::columnsAboutToBeInserted, this, [this](const QModelIndex &, int first, int last) {
             beginInsertRows(QModelIndex{}, first, last);
         });
         connect(newSourceModel, &QAbstractItemModel::columnsInserted, this, [this]() {
+            d->headers.clear();
             endInsertRows();
         });
         connect(newSourceModel,
@@ -94,28 +129,54 @@ void KColumnHeadersModel::setSourceModel(QAbstractItemModel *newSourceModel)
                     beginMoveRows(QModelIndex{}, start, end, QModelIndex{}, destination);
                 });
         connect(newSourceModel, &QAbstractItemModel::columnsMoved, this, [this]() {
+            d->headers.clear();
             endMoveRows();
         });
         connect(newSourceModel, &QAbstractItemModel::columnsAboutToBeRemoved, this, [this](const QModelIndex &, int first, int last) {
             beginRemoveRows(QModelIndex{}, first, last);
         });
         connect(newSourceModel, &QAbstractItemModel::columnsRemoved, this, [this]() {
+            d->headers.clear();
             endRemoveRows();
         });
         connect(newSourceModel, &QAbstractItemModel::headerDataChanged, this, [this](Qt::Orientation orientation, int first, int last) {
             if (orientation == Qt::Horizontal) {
+                d->clearHeaders(first, last);
                 Q_EMIT dataChanged(index(first, 0), index(last, 0));
             }
         });
+        connect(newSourceModel, &QAbstractItemModel::layoutAboutToBeChanged, this, &KColumnHeadersModel::onLayoutAboutToBeChanged);
+        connect(newSourceModel, &QAbstractItemModel::layoutChanged, this, &KColumnHeadersModel::onLayoutChanged);
         connect(newSourceModel, &QAbstractItemModel::modelAboutToBeReset, this, [this]() {
             beginResetModel();
         });
         connect(newSourceModel, &QAbstractItemModel::modelReset, this, [this]() {
+            // The role names can only change on reset
+            d->headers.clear();
+            d->updateRoleNames();
             endResetModel();
         });
     }
 }
 
+void KColumnHeadersModel::onLayoutAboutToBeChanged(const QList<QPersistentModelIndex> &parents, QAbstractItemModel::LayoutChangeHint hint)
+{
+    Q_UNUSED(parents);
+    // Sorting the rows of the source model doesn't change its headers
+    if (hint != QAbstractItemModel::VerticalSortHint) {
+        Q_EMIT layoutAboutToBeChanged({}, QAbstractItemModel::VerticalSortHint);
+    }
+}
+
+void KColumnHeadersModel::onLayoutChanged(const QList<QPersistentModelIndex> &parents, QAbstractItemModel::LayoutChangeHint hint)
+{
+    Q_UNUSED(parents);
+    if (hint != QAbstractItemModel::VerticalSortHint) {
+        d->headers.clear();
+        Q_EMIT layoutChanged({}, QAbstractItemModel::VerticalSortHint);
+    }
+}
+
 int KColumnHeadersModel::sortColumn() const
 {
     return d->sortColumn;
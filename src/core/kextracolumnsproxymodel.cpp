@@ -8,7 +8,55 @@
 #include "kextracolumnsproxymodel.h"
 #include "kitemmodels_debug.h"
 
+#include <QCache>
+#include <QHash>
 #include <QItemSelection>
+#include <QMutex>
+#include <QSet>
+#include <QThreadPool>
+
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <tuple>
+#include <utility>
+
+// Identifies a row of the proxy, by the internal id of its index in column 0
+struct ExtraColumnDataCacheKey {
+    quintptr internalId;
+    int row;
+
+    friend bool operator==(const ExtraColumnDataCacheKey &lhs, const ExtraColumnDataCacheKey &rhs)
+    {
+        return lhs.internalId == rhs.internalId && lhs.row == rhs.row;
+    }
+    friend size_t qHash(const ExtraColumnDataCacheKey &key, size_t seed = 0)
+    {
+        return qHashMulti(seed, key.internalId, key.row);
+    }
+};
+
+struct CachedExtraColumnData {
+    int extraColumn;
+    int role;
+    QVariant data;
+};
+
+// A job of asyncExtraColumnData() which didn't deliver its result yet
+struct ExtraColumnDataJob {
+    int extraColumn;
+    int role;
+    // The row in the source model, to find it again when the job finishes
+    QPersistentModelIndex sourceIndex;
+    // Set to cancel the job
+    std::shared_ptr<std::atomic_bool> cancelled;
+};
+
+// Shared with the jobs running in the thread pool, so that they don't deliver their results to a deleted proxy
+struct ExtraColumnDataJobContext {
+    QMutex mutex;
+    KExtraColumnsProxyModelPrivate *d = nullptr;
+};
 
 class KExtraColumnsProxyModelPrivate
 {
@@ -18,21 +66,301 @@ class KExtraColumnsProxyModelPrivate
 public:
     KExtraColumnsProxyModelPrivate(KExtraColumnsProxyModel *model)
         : q_ptr(model)
+        , m_jobContext(std::make_shared<ExtraColumnDataJobContext>())
     {
+        m_jobContext->d = this;
+        // The least recently used results are computed again if they are needed
+        m_asyncExtraColumnData.setMaxCost(1000);
     }
 
     void _ec_sourceLayoutAboutToBeChanged(const QList<QPersistentModelIndex> &sourceParents, QAbstractItemModel::LayoutChangeHint hint);
     void _ec_sourceLayoutChanged(const QList<QPersistentModelIndex> &sourceParents, QAbstractItemModel::LayoutChangeHint hint);
 
-    // Configuration (doesn't change once source model is plugged in)
-    QList<QString> m_extraHeaders;
-
-    // for layoutAboutToBeChanged/layoutChanged
-    QList<QPersistentModelIndex> layoutChangePersistentIndexes;
-    QList<int> layoutChangeProxyColumns;
-    QModelIndexList proxyIndexes;
+    void sourceDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QList<int> &roles);
+
+    // Configuration
+    struct ExtraColumn {
+        QString header;
+        // The source columns and roles the extra column is computed from, see setExtraColumnDependencies
+        QList<int> sourceColumns;
+        QList<int> roles;
+    };
+    QList<ExtraColumn> m_extraColumns;
+
+    // for layoutAboutToBeChanged/layoutChanged: the persistent indexes under the changed parents,
+    // with the source index of their row, to find them again afterwards
+    struct LayoutChangeIndex {
+        QModelIndex proxyIndex;
+        QPersistentModelIndex sourceIndex;
+    };
+    QList<LayoutChangeIndex> m_layoutChangeIndexes;
+
+    QVariant cachedExtraColumnData(const QModelIndex &index, int extraColumn, int role) const;
+    void invalidateExtraColumnData(const QModelIndex &sourceParent, int first, int last);
+    void invalidateExtraColumnData(const ExtraColumnDataCacheKey &key);
+    void invalidateFollowingRows(const QModelIndex &sourceParent, int first);
+    void invalidateSubtrees(const QModelIndex &sourceParent, int first, int last);
+    void clearExtraColumnData();
+    void moveChildExtraColumns(int firstExtraColumn, int delta);
+    void asyncExtraColumnDataFinished(const ExtraColumnDataCacheKey &key, const std::shared_ptr<std::atomic_bool> &cancelled, const QVariant &data);
+    void emitFinishedExtraColumnData();
+
+    // Opt-in cache of the extra column data, one entry per row, least recently used rows first out.
+    // It's keyed by position: the rows which move or go away when the source model inserts,
+    // removes or moves rows are invalidated, the cache is cleared on the other structural changes.
+    mutable QCache<ExtraColumnDataCacheKey, QList<CachedExtraColumnData>> m_extraColumnDataCache;
+    int m_extraColumnDataCacheSize = 0;
+    QList<QMetaObject::Connection> m_sourceModelConnections;
+
+    // The results of asyncExtraColumnData(), per row, invalidated like m_extraColumnDataCache
+    mutable QCache<ExtraColumnDataCacheKey, QList<CachedExtraColumnData>> m_asyncExtraColumnData;
+    // The running jobs of asyncExtraColumnData(), per row. Those of rows which move or go away are cancelled.
+    mutable QHash<ExtraColumnDataCacheKey, QList<ExtraColumnDataJob>> m_extraColumnDataJobs;
+    const std::shared_ptr<ExtraColumnDataJobContext> m_jobContext;
+    // The cells whose job finished since the last dataChanged
+    struct FinishedCell {
+        QPersistentModelIndex index;
+        int role;
+    };
+    QList<FinishedCell> m_finishedCells;
 };
 
+QVariant KExtraColumnsProxyModelPrivate::cachedExtraColumnData(const QModelIndex &index, int extraColumn, int role) const
+{
+    Q_Q(const KExtraColumnsProxyModel);
+    const ExtraColumnDataCacheKey key{index.internalId(), index.row()};
+    if (const QList<CachedExtraColumnData> *cachedRow = m_extraColumnDataCache.object(key)) {
+        for (const CachedExtraColumnData &cached : *cachedRow) {
+            if (cached.extraColumn == extraColumn && cached.role == role) {
+                return cached.data;
+            }
+        }
+    }
+
+    // Look the row up again afterwards, extraColumnData() could have evicted it
+    const QVariant data = q->extraColumnData(index.parent(), index.row(), extraColumn, role);
+    QList<CachedExtraColumnData> *cachedRow = m_extraColumnDataCache.object(key);
+    if (!cachedRow) {
+        cachedRow = new QList<CachedExtraColumnData>;
+        if (!m_extraColumnDataCache.insert(key, cachedRow)) {
+            return data;
+        }
+    }
+    cachedRow->append({extraColumn, role, data});
+    return data;
+}
+
+static void cancelJobs(const QList<ExtraColumnDataJob> &jobs)
+{
+    for (const ExtraColumnDataJob &job : jobs) {
+        *job.cancelled = true;
+    }
+}
+
+void KExtraColumnsProxyModelPrivate::invalidateExtraColumnData(const QModelIndex &sourceParent, int first, int last)
+{
+    Q_Q(KExtraColumnsProxyModel);
+    const qsizetype cachedRowCount = m_extraColumnDataCache.size() + m_asyncExtraColumnData.size() + m_extraColumnDataJobs.size();
+    if (cachedRowCount == 0) {
+        return;
+    }
+    if (last - first + 1 <= cachedRowCount) {
+        for (int row = first; row <= last; ++row) {
+            invalidateExtraColumnData({q->sourceModel()->index(row, 0, sourceParent).internalId(), row});
+        }
+        return;
+    }
+
+    // Fewer rows are cached than invalidated, look at the cached rows instead
+    QSet<ExtraColumnDataCacheKey> keys;
+    keys.reserve(cachedRowCount);
+    const QList<ExtraColumnDataCacheKey> cacheKeys = m_extraColumnDataCache.keys();
+    keys.unite(QSet<ExtraColumnDataCacheKey>(cacheKeys.cbegin(), cacheKeys.cend()));
+    const QList<ExtraColumnDataCacheKey> asyncKeys = m_asyncExtraColumnData.keys();
+    keys.unite(QSet<ExtraColumnDataCacheKey>(asyncKeys.cbegin(), asyncKeys.cend()));
+    for (auto it = m_extraColumnDataJobs.cbegin(); it != m_extraColumnDataJobs.cend(); ++it) {
+        keys.insert(it.key());
+    }
+    for (const ExtraColumnDataCacheKey &key : std::as_const(keys)) {
+        if (key.row >= first && key.row <= last && q->sourceModel()->index(key.row, 0, sourceParent).internalId() == key.internalId) {
+            invalidateExtraColumnData(key);
+        }
+    }
+}
+
+void KExtraColumnsProxyModelPrivate::invalidateExtraColumnData(const ExtraColumnDataCacheKey &key)
+{
+    m_extraColumnDataCache.remove(key);
+    m_asyncExtraColumnData.remove(key);
+    const auto it = m_extraColumnDataJobs.find(key);
+    if (it != m_extraColumnDataJobs.end()) {
+        cancelJobs(*it);
+        m_extraColumnDataJobs.erase(it);
+    }
+}
+
+// The rows are keyed by position: when rows are inserted, removed or moved under
+// sourceParent, the rows from first onwards are invalidated. So are sourceParent and
+// its ancestors, whose extra columns can aggregate their children, e.g. a total size.
+void KExtraColumnsProxyModelPrivate::invalidateFollowingRows(const QModelIndex &sourceParent, int first)
+{
+    Q_Q(KExtraColumnsProxyModel);
+    const int rowCount = q->sourceModel()->rowCount(sourceParent);
+    if (first < rowCount) {
+        invalidateExtraColumnData(sourceParent, first, rowCount - 1);
+    }
+    for (QModelIndex ancestor = sourceParent; ancestor.isValid(); ancestor = ancestor.parent()) {
+        if (m_extraColumnDataCache.isEmpty() && m_asyncExtraColumnData.isEmpty() && m_extraColumnDataJobs.isEmpty()) {
+            return;
+        }
+        invalidateExtraColumnData({ancestor.sibling(ancestor.row(), 0).internalId(), ancestor.row()});
+    }
+}
+
+// The internal ids of removed rows can be reused by other rows, invalidate their descendants too
+void KExtraColumnsProxyModelPrivate::invalidateSubtrees(const QModelIndex &sourceParent, int first, int last)
+{
+    Q_Q(KExtraColumnsProxyModel);
+    for (int row = first; row <= last; ++row) {
+        if (m_extraColumnDataCache.isEmpty() && m_asyncExtraColumnData.isEmpty() && m_extraColumnDataJobs.isEmpty()) {
+            return;
+        }
+        const QModelIndex sourceIndex = q->sourceModel()->index(row, 0, sourceParent);
+        const int childCount = q->sourceModel()->rowCount(sourceIndex);
+        if (childCount > 0) {
+            invalidateExtraColumnData(sourceIndex, 0, childCount - 1);
+            invalidateSubtrees(sourceIndex, 0, childCount - 1);
+        }
+    }
+}
+
+void KExtraColumnsProxyModelPrivate::clearExtraColumnData()
+{
+    m_extraColumnDataCache.clear();
+    m_asyncExtraColumnData.clear();
+    for (const QList<ExtraColumnDataJob> &jobs : std::as_const(m_extraColumnDataJobs)) {
+        cancelJobs(jobs);
+    }
+    m_extraColumnDataJobs.clear();
+    m_finishedCells.clear();
+}
+
+// Column insertions and removals are signalled under the root only: move the persistent
+// indexes of the extra columns in the subtrees ourselves. Those of the removed columns
+// are invalidated.
+void KExtraColumnsProxyModelPrivate::moveChildExtraColumns(int firstExtraColumn, int delta)
+{
+    Q_Q(KExtraColumnsProxyModel);
+    const int firstColumn = q->proxyColumnForExtraColumn(firstExtraColumn);
+    const QModelIndexList persistentIndexes = q->persistentIndexList();
+    QModelIndexList from;
+    QModelIndexList to;
+    for (const QModelIndex &proxyIndex : persistentIndexes) {
+        if (proxyIndex.column() < firstColumn || !proxyIndex.parent().isValid()) {
+            continue;
+        }
+        from.append(proxyIndex);
+        if (delta < 0 && proxyIndex.column() < firstColumn - delta) {
+            to.append(QModelIndex());
+        } else {
+            to.append(q->createIndex(proxyIndex.row(), proxyIndex.column() + delta, proxyIndex.internalPointer()));
+        }
+    }
+    q->changePersistentIndexList(from, to);
+}
+
+void KExtraColumnsProxyModelPrivate::asyncExtraColumnDataFinished(const ExtraColumnDataCacheKey &key,
+                                                                  const std::shared_ptr<std::atomic_bool> &cancelled,
+                                                                  const QVariant &data)
+{
+    Q_Q(KExtraColumnsProxyModel);
+    if (*cancelled) {
+        return;
+    }
+    const auto it = m_extraColumnDataJobs.find(key);
+    if (it == m_extraColumnDataJobs.end()) {
+        return;
+    }
+    const auto jobIt = std::find_if(it->cbegin(), it->cend(), [&](const ExtraColumnDataJob &job) {
+        return job.cancelled == cancelled;
+    });
+    if (jobIt == it->cend()) {
+        return;
+    }
+    const ExtraColumnDataJob job = *jobIt;
+    it->erase(jobIt);
+    if (it->isEmpty()) {
+        m_extraColumnDataJobs.erase(it);
+    }
+    if (!job.sourceIndex.isValid()) {
+        return;
+    }
+
+    QList<CachedExtraColumnData> *results = m_asyncExtraColumnData.object(key);
+    if (!results) {
+        results = new QList<CachedExtraColumnData>;
+        if (!m_asyncExtraColumnData.insert(key, results)) {
+            return;
+        }
+    }
+    results->append({job.extraColumn, job.role, data});
+    // The placeholder could be cached
+    m_extraColumnDataCache.remove(key);
+
+    if (m_finishedCells.isEmpty()) {
+        QMetaObject::invokeMethod(
+            q,
+            [this] {
+                emitFinishedExtraColumnData();
+            },
+            Qt::QueuedConnection);
+    }
+    const QModelIndex proxyIndex = q->mapFromSource(job.sourceIndex);
+    m_finishedCells.append({q->index(proxyIndex.row(), q->proxyColumnForExtraColumn(job.extraColumn), proxyIndex.parent()), job.role});
+}
+
+void KExtraColumnsProxyModelPrivate::emitFinishedExtraColumnData()
+{
+    Q_Q(KExtraColumnsProxyModel);
+    // The cells are followed by persistent indexes, as rows can be inserted or removed meanwhile
+    struct Cell {
+        QModelIndex index;
+        int role;
+    };
+    QList<Cell> finishedCells;
+    finishedCells.reserve(m_finishedCells.size());
+    for (const FinishedCell &finishedCell : std::as_const(m_finishedCells)) {
+        if (finishedCell.index.isValid()) {
+            finishedCells.append({finishedCell.index, finishedCell.role});
+        }
+    }
+    m_finishedCells.clear();
+    if (finishedCells.isEmpty()) {
+        return;
+    }
+
+    // One dataChanged per contiguous span of rows of each extra column, under each parent
+    std::sort(finishedCells.begin(), finishedCells.end(), [](const Cell &lhs, const Cell &rhs) {
+        return std::make_tuple(lhs.index.parent(), lhs.index.column(), lhs.index.row())
+            < std::make_tuple(rhs.index.parent(), rhs.index.column(), rhs.index.row());
+    });
+    auto cell = finishedCells.cbegin();
+    while (cell != finishedCells.cend()) {
+        const QModelIndex first = cell->index;
+        QModelIndex last = first;
+        QList<int> roles{cell->role};
+        for (++cell; cell != finishedCells.cend() && cell->index.parent() == first.parent() && cell->index.column() == first.column()
+             && cell->index.row() <= last.row() + 1;
+             ++cell) {
+            last = cell->index;
+            if (!roles.contains(cell->role)) {
+                roles.append(cell->role);
+            }
+        }
+        Q_EMIT q->dataChanged(first, last, roles);
+    }
+}
+
 KExtraColumnsProxyModel::KExtraColumnsProxyModel(QObject *parent)
     : QIdentityProxyModel(parent)
     , d_ptr(new KExtraColumnsProxyModelPrivate(this))
@@ -40,22 +368,119 @@ KExtraColumnsProxyModel::KExtraColumnsProxyModel(QObject *parent)
     // The handling of persistent model indexes assumes mapToSource can be called for any index
     // This breaks for the extra column, so we'll have to do it ourselves
     setHandleSourceLayoutChanges(false);
+    // Data changes can extend to the dependent extra columns, see setExtraColumnDependencies
+    setHandleSourceDataChanges(false);
 }
 
 KExtraColumnsProxyModel::~KExtraColumnsProxyModel()
 {
+    Q_D(KExtraColumnsProxyModel);
+    QMutexLocker locker(&d->m_jobContext->mutex);
+    d->m_jobContext->d = nullptr;
+    for (const QList<ExtraColumnDataJob> &jobs : std::as_const(d->m_extraColumnDataJobs)) {
+        cancelJobs(jobs);
+    }
 }
 
 void KExtraColumnsProxyModel::appendColumn(const QString &header)
 {
     Q_D(KExtraColumnsProxyModel);
-    d->m_extraHeaders.append(header);
+    insertExtraColumn(d->m_extraColumns.size(), header);
+}
+
+void KExtraColumnsProxyModel::insertExtraColumn(int idx, const QString &header)
+{
+    Q_D(KExtraColumnsProxyModel);
+    Q_ASSERT(idx >= 0 && idx <= d->m_extraColumns.size());
+    // The cached values are keyed by extra column number
+    d->clearExtraColumnData();
+    if (!sourceModel()) {
+        d->m_extraColumns.insert(idx, {header, {}, {}});
+        return;
+    }
+    const int column = proxyColumnForExtraColumn(idx);
+    beginInsertColumns(QModelIndex(), column, column);
+    d->moveChildExtraColumns(idx, 1);
+    d->m_extraColumns.insert(idx, {header, {}, {}});
+    endInsertColumns();
 }
 
 void KExtraColumnsProxyModel::removeExtraColumn(int idx)
 {
     Q_D(KExtraColumnsProxyModel);
-    d->m_extraHeaders.remove(idx);
+    Q_ASSERT(idx >= 0 && idx < d->m_extraColumns.size());
+    d->clearExtraColumnData();
+    if (!sourceModel()) {
+        d->m_extraColumns.remove(idx);
+        return;
+    }
+    const int column = proxyColumnForExtraColumn(idx);
+    beginRemoveColumns(QModelIndex(), column, column);
+    d->moveChildExtraColumns(idx, -1);
+    d->m_extraColumns.remove(idx);
+    endRemoveColumns();
+}
+
+int KExtraColumnsProxyModel::extraColumnCount() const
+{
+    Q_D(const KExtraColumnsProxyModel);
+    return d->m_extraColumns.size();
+}
+
+void KExtraColumnsProxyModel::setExtraColumnDataCacheSize(int rowCount)
+{
+    Q_D(KExtraColumnsProxyModel);
+    d->m_extraColumnDataCacheSize = std::max(0, rowCount);
+    d->m_extraColumnDataCache.setMaxCost(d->m_extraColumnDataCacheSize);
+}
+
+int KExtraColumnsProxyModel::extraColumnDataCacheSize() const
+{
+    Q_D(const KExtraColumnsProxyModel);
+    return d->m_extraColumnDataCacheSize;
+}
+
+void KExtraColumnsProxyModel::setExtraColumnDependencies(int extraColumn, const QList<int> &sourceColumns, const QList<int> &roles)
+{
+    Q_D(KExtraColumnsProxyModel);
+    Q_ASSERT(extraColumn >= 0 && extraColumn < d->m_extraColumns.size());
+    KExtraColumnsProxyModelPrivate::ExtraColumn &column = d->m_extraColumns[extraColumn];
+    column.sourceColumns = sourceColumns;
+    column.roles = roles;
+}
+
+void KExtraColumnsProxyModelPrivate::sourceDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QList<int> &roles)
+{
+    Q_Q(KExtraColumnsProxyModel);
+    Q_ASSERT(topLeft.isValid() ? topLeft.model() == q->sourceModel() : true);
+    Q_ASSERT(bottomRight.isValid() ? bottomRight.model() == q->sourceModel() : true);
+
+    Q_EMIT q->dataChanged(q->mapFromSource(topLeft), q->mapFromSource(bottomRight), roles);
+
+    // Also notify the extra columns which depend on the changed cells, one range per run of
+    // consecutive dependent columns. Which roles of the extra columns change isn't known.
+    const QModelIndex proxyParent = q->mapFromSource(topLeft.parent());
+    int firstDependentColumn = -1;
+    for (int extraColumn = 0; extraColumn <= m_extraColumns.size(); ++extraColumn) {
+        bool dependent = false;
+        if (extraColumn < m_extraColumns.size()) {
+            const ExtraColumn &column = m_extraColumns.at(extraColumn);
+            const bool dependsOnColumns = std::any_of(column.sourceColumns.cbegin(), column.sourceColumns.cend(), [&](int sourceColumn) {
+                return sourceColumn >= topLeft.column() && sourceColumn <= bottomRight.column();
+            });
+            const bool dependsOnRoles = roles.isEmpty() || column.roles.isEmpty() || std::any_of(roles.cbegin(), roles.cend(), [&](int role) {
+                                            return column.roles.contains(role);
+                                        });
+            dependent = dependsOnColumns && dependsOnRoles;
+        }
+        if (dependent && firstDependentColumn < 0) {
+            firstDependentColumn = extraColumn;
+        } else if (!dependent && firstDependentColumn >= 0) {
+            Q_EMIT q->dataChanged(q->index(topLeft.row(), q->proxyColumnForExtraColumn(firstDependentColumn), proxyParent),
+                                  q->index(bottomRight.row(), q->proxyColumnForExtraColumn(extraColumn - 1), proxyParent));
+            firstDependentColumn = -1;
+        }
+    }
 }
 
 bool KExtraColumnsProxyModel::setExtraColumnData(const QModelIndex &parent, int row, int extraColumn, const QVariant &data, int role)
@@ -70,12 +495,67 @@ bool KExtraColumnsProxyModel::setExtraColumnData(const QModelIndex &parent, int
 
 void KExtraColumnsProxyModel::extraColumnDataChanged(const QModelIndex &parent, int row, int extraColumn, const QList<int> &roles)
 {
+    Q_D(KExtraColumnsProxyModel);
     const QModelIndex idx = index(row, proxyColumnForExtraColumn(extraColumn), parent);
+    d->invalidateExtraColumnData(ExtraColumnDataCacheKey{idx.internalId(), row});
     Q_EMIT dataChanged(idx, idx, roles);
 }
 
+QVariant KExtraColumnsProxyModel::asyncExtraColumnData(const QModelIndex &parent,
+                                                       int row,
+                                                       int extraColumn,
+                                                       int role,
+                                                       const std::function<QVariant()> &job,
+                                                       const QVariant &placeholder) const
+{
+    Q_D(const KExtraColumnsProxyModel);
+    const QModelIndex sourceIndex = mapToSource(index(row, 0, parent));
+    const ExtraColumnDataCacheKey key{sourceIndex.internalId(), row};
+    if (const QList<CachedExtraColumnData> *results = d->m_asyncExtraColumnData.object(key)) {
+        for (const CachedExtraColumnData &result : *results) {
+            if (result.extraColumn == extraColumn && result.role == role) {
+                return result.data;
+            }
+        }
+    }
+    QList<ExtraColumnDataJob> &jobs = d->m_extraColumnDataJobs[key];
+    for (const ExtraColumnDataJob &runningJob : std::as_const(jobs)) {
+        if (runningJob.extraColumn == extraColumn && runningJob.role == role) {
+            return placeholder;
+        }
+    }
+
+    const auto cancelled = std::make_shared<std::atomic_bool>(false);
+    jobs.append({extraColumn, role, QPersistentModelIndex(sourceIndex), cancelled});
+    QThreadPool::globalInstance()->start([context = d->m_jobContext, cancelled, job, key]() {
+        if (*cancelled) {
+            return;
+        }
+        const QVariant data = job();
+        QMutexLocker locker(&context->mutex);
+        if (!context->d || *cancelled) {
+            return;
+        }
+        KExtraColumnsProxyModelPrivate *const d = context->d;
+        QMetaObject::invokeMethod(
+            d->q_func(),
+            [d, key, cancelled, data] {
+                d->asyncExtraColumnDataFinished(key, cancelled, data);
+            },
+            Qt::QueuedConnection);
+    });
+    return placeholder;
+}
+
 void KExtraColumnsProxyModel::setSourceModel(QAbstractItemModel *model)
 {
+    Q_D(KExtraColumnsProxyModel);
+    for (const QMetaObject::Connection &connection : std::as_const(d->m_sourceModelConnections)) {
+        disconnect(connection);
+    }
+    d->m_sourceModelConnections.clear();
+    d->clearExtraColumnData();
+
     if (sourceModel()) {
         disconnect(sourceModel(),
                    SIGNAL(layoutAboutToBeChanged(QList<QPersistentModelIndex>, QAbstractItemModel::LayoutChangeHint)),
@@ -87,6 +567,51 @@ void KExtraColumnsProxyModel::setSourceModel(QAbstractItemModel *model)
                    SLOT(_ec_sourceLayoutChanged(QList<QPersistentModelIndex>, QAbstractItemModel::LayoutChangeHint)));
     }
 
+    if (model) {
+        // Connected before QIdentityProxyModel forwards the other signals, so that the cache
+        // is up to date when the views react to them
+        const auto clearCache = [d] {
+            d->clearExtraColumnData();
+        };
+        // Before the change for the ids of the rows which move, after it for the values queried meanwhile
+        const auto invalidateFollowingRows = [d](const QModelIndex &parent, int first) {
+            d->invalidateFollowingRows(parent, first);
+        };
+        const auto invalidateMovedRows = [d](const QModelIndex &sourceParent,
+                                             int sourceStart,
+                                             int,
+                                             const QModelIndex &destinationParent,
+                                             int destinationRow) {
+            d->invalidateFollowingRows(sourceParent, sourceStart);
+            d->invalidateFollowingRows(destinationParent, destinationRow);
+        };
+        d->m_sourceModelConnections = {
+            connect(model,
+                    &QAbstractItemModel::dataChanged,
+                    this,
+                    [d](const QModelIndex &topLeft, const QModelIndex &bottomRight, const QList<int> &roles) {
+                        d->invalidateExtraColumnData(topLeft.parent(), topLeft.row(), bottomRight.row());
+                        d->sourceDataChanged(topLeft, bottomRight, roles);
+                    }),
+            connect(model, &QAbstractItemModel::rowsAboutToBeInserted, this, invalidateFollowingRows),
+            connect(model, &QAbstractItemModel::rowsInserted, this, invalidateFollowingRows),
+            connect(model,
+                    &QAbstractItemModel::rowsAboutToBeRemoved,
+                    this,
+                    [d](const QModelIndex &parent, int first, int last) {
+                        d->invalidateSubtrees(parent, first, last);
+                        d->invalidateFollowingRows(parent, first);
+                    }),
+            connect(model, &QAbstractItemModel::rowsRemoved, this, invalidateFollowingRows),
+            connect(model, &QAbstractItemModel::rowsAboutToBeMoved, this, invalidateMovedRows),
+            connect(model, &QAbstractItemModel::rowsMoved, this, invalidateMovedRows),
+            connect(model, &QAbstractItemModel::columnsInserted, this, clearCache),
+            connect(model, &QAbstractItemModel::columnsRemoved, this, clearCache),
+            connect(model, &QAbstractItemModel::columnsMoved, this, clearCache),
+            connect(model, &QAbstractItemModel::modelReset, this, clearCache),
+        };
+    }
+
     QIdentityProxyModel::setSourceModel(model);
 
     if (model) {
@@ -135,6 +660,57 @@ QModelIndex KExtraColumnsProxyModel::sibling(int row, int column, const QModelIn
     return index(row, column, parent(idx));
 }
 
+namespace
+{
+// Rows first to last of the source columns 0 to lastColumn, under parent
+struct SourceRowSpan {
+    QModelIndex parent;
+    int lastColumn;
+    int first;
+    int last;
+};
+using RowInterval = std::pair<int, int>;
+
+// Appends the intervals of sorted, merged \a intervals which aren't in sorted, merged \a covered
+void subtractIntervals(const QList<RowInterval> &intervals, const QList<RowInterval> &covered, QList<RowInterval> &result)
+{
+    auto coveredIt = covered.cbegin();
+    for (RowInterval interval : intervals) {
+        while (coveredIt != covered.cend() && coveredIt->second < interval.first) {
+            ++coveredIt;
+        }
+        for (auto it = coveredIt; it != covered.cend() && it->first <= interval.second; ++it) {
+            if (it->first > interval.first) {
+                result.append({interval.first, it->first - 1});
+            }
+            interval.first = it->second + 1;
+            if (interval.first > interval.second) {
+                break;
+            }
+        }
+        if (interval.first <= interval.second) {
+            result.append(interval);
+        }
+    }
+}
+
+// Merges sorted, merged \a intervals into sorted, merged \a covered
+void uniteIntervals(QList<RowInterval> &covered, const QList<RowInterval> &intervals)
+{
+    QList<RowInterval> united;
+    united.reserve(covered.size() + intervals.size());
+    std::merge(covered.cbegin(), covered.cend(), intervals.cbegin(), intervals.cend(), std::back_inserter(united));
+    covered.clear();
+    for (const RowInterval &interval : std::as_const(united)) {
+        if (!covered.isEmpty() && interval.first <= covered.last().second + 1) {
+            covered.last().second = std::max(covered.last().second, interval.second);
+        } else {
+            covered.append(interval);
+        }
+    }
+}
+}
+
 QItemSelection KExtraColumnsProxyModel::mapSelectionToSource(const QItemSelection &selection) const
 {
     QItemSelection sourceSelection;
@@ -144,27 +720,54 @@ QItemSelection KExtraColumnsProxyModel::mapSelectionToSource(const QItemSelectio
     }
 
     // mapToSource will give invalid index for our additional columns, so truncate the selection
-    // to the columns known by the source model
+    // to the columns known by the source model. The mapped ranges all start at column 0.
     const int sourceColumnCount = sourceModel()->columnCount();
+    if (sourceColumnCount == 0) {
+        return sourceSelection;
+    }
+    QList<SourceRowSpan> spans;
+    spans.reserve(selection.size());
     QItemSelection::const_iterator it = selection.constBegin();
     const QItemSelection::const_iterator end = selection.constEnd();
     for (; it != end; ++it) {
         Q_ASSERT(it->model() == this);
-        QModelIndex topLeft = it->topLeft();
-        Q_ASSERT(topLeft.isValid());
-        Q_ASSERT(topLeft.model() == this);
-        topLeft = topLeft.sibling(topLeft.row(), 0);
-        QModelIndex bottomRight = it->bottomRight();
-        Q_ASSERT(bottomRight.isValid());
-        Q_ASSERT(bottomRight.model() == this);
-        if (bottomRight.column() >= sourceColumnCount) {
-            bottomRight = bottomRight.sibling(bottomRight.row(), sourceColumnCount - 1);
-        }
-        // This can lead to duplicate source indexes, so use merge().
-        const QItemSelectionRange range(mapToSource(topLeft), mapToSource(bottomRight));
-        QItemSelection newSelection;
-        newSelection << range;
-        sourceSelection.merge(newSelection, QItemSelectionModel::Select);
+        Q_ASSERT(it->topLeft().isValid());
+        Q_ASSERT(it->bottomRight().isValid());
+        spans.append({mapToSource(it->parent()), std::min(it->right(), sourceColumnCount - 1), it->top(), it->bottom()});
+    }
+
+    // Several ranges can cover the same source cells, which mustn't be duplicated. Sort by
+    // parent, then from the widest ranges to the narrowest, so that each group of ranges
+    // of the same width can be merged in one pass and reduced to the rows not covered yet.
+    std::sort(spans.begin(), spans.end(), [](const SourceRowSpan &lhs, const SourceRowSpan &rhs) {
+        return std::tie(lhs.parent, rhs.lastColumn, lhs.first) < std::tie(rhs.parent, lhs.lastColumn, rhs.first);
+    });
+
+    QList<RowInterval> covered;
+    QList<RowInterval> intervals;
+    QList<RowInterval> uncovered;
+    auto span = spans.cbegin();
+    while (span != spans.cend()) {
+        const QModelIndex parent = span->parent;
+        covered.clear();
+        while (span != spans.cend() && span->parent == parent) {
+            const int lastColumn = span->lastColumn;
+            intervals.clear();
+            for (; span != spans.cend() && span->parent == parent && span->lastColumn == lastColumn; ++span) {
+                if (!intervals.isEmpty() && span->first <= intervals.last().second + 1) {
+                    intervals.last().second = std::max(intervals.last().second, span->last);
+                } else {
+                    intervals.append({span->first, span->last});
+                }
+            }
+            uncovered.clear();
+            subtractIntervals(intervals, covered, uncovered);
+            for (const RowInterval &interval : std::as_const(uncovered)) {
+                sourceSelection.append(
+                    QItemSelectionRange(sourceModel()->index(interval.first, 0, parent), sourceModel()->index(interval.second, lastColumn, parent)));
+            }
+            uniteIntervals(covered, intervals);
+        }
     }
 
     return sourceSelection;
@@ -173,14 +776,17 @@ QItemSelection KExtraColumnsProxyModel::mapSelectionToSource(const QItemSelectio
 int KExtraColumnsProxyModel::columnCount(const QModelIndex &parent) const
 {
     Q_D(const KExtraColumnsProxyModel);
-    return QIdentityProxyModel::columnCount(parent) + d->m_extraHeaders.count();
+    return QIdentityProxyModel::columnCount(parent) + d->m_extraColumns.count();
 }
 
 QVariant KExtraColumnsProxyModel::data(const QModelIndex &index, int role) const
 {
     Q_D(const KExtraColumnsProxyModel);
     const int extraCol = extraColumnForProxyColumn(index.column());
-    if (extraCol >= 0 && !d->m_extraHeaders.isEmpty()) {
+    if (extraCol >= 0 && !d->m_extraColumns.isEmpty()) {
+        if (d->m_extraColumnDataCacheSize > 0) {
+            return d->cachedExtraColumnData(index, extraCol, role);
+        }
         return extraColumnData(index.parent(), index.row(), extraCol, role);
     }
     return sourceModel()->data(mapToSource(index), role);
@@ -190,7 +796,7 @@ bool KExtraColumnsProxyModel::setData(const QModelIndex &index, const QVariant &
 {
     Q_D(const KExtraColumnsProxyModel);
     const int extraCol = extraColumnForProxyColumn(index.column());
-    if (extraCol >= 0 && !d->m_extraHeaders.isEmpty()) {
+    if (extraCol >= 0 && !d->m_extraColumns.isEmpty()) {
         return setExtraColumnData(index.parent(), index.row(), extraCol, value, role);
     }
     return sourceModel()->setData(mapToSource(index), value, role);
@@ -222,7 +828,7 @@ QVariant KExtraColumnsProxyModel::headerData(int section, Qt::Orientation orient
         if (extraCol >= 0) {
             // Only text is supported, in headers for extra columns
             if (role == Qt::DisplayRole) {
-                return d->m_extraHeaders.at(extraCol);
+                return d->m_extraColumns.at(extraCol).header;
             }
             return QVariant();
         }
@@ -275,51 +881,89 @@ void KExtraColumnsProxyModelPrivate::_ec_sourceLayoutAboutToBeChanged(const QLis
 
     QList<QPersistentModelIndex> parents;
     parents.reserve(sourceParents.size());
+    // Only the persistent indexes under the changed parents need to be remapped, unless
+    // the whole model changes
+    bool allChanged = sourceParents.isEmpty();
+    QSet<QModelIndex> changedParents;
     for (const QPersistentModelIndex &parent : sourceParents) {
         if (!parent.isValid()) {
             parents << QPersistentModelIndex();
+            allChanged = true;
             continue;
         }
         const QModelIndex mappedParent = q->mapFromSource(parent);
         Q_ASSERT(mappedParent.isValid());
         parents << mappedParent;
+        changedParents.insert(mappedParent.siblingAtColumn(0));
     }
 
     Q_EMIT q->layoutAboutToBeChanged(parents, hint);
 
-    const QModelIndexList persistentIndexList = q->persistentIndexList();
-    layoutChangePersistentIndexes.reserve(persistentIndexList.size());
-    layoutChangeProxyColumns.reserve(persistentIndexList.size());
+    // Whether each parent seen so far is one of the changed parents or a descendant of them,
+    // so that each ancestor is only looked at once, whatever the number of its children
+    QHash<QModelIndex, bool> underChangedParents;
+    const auto isUnderChangedParent = [&](const QModelIndex &proxyIndex) {
+        QModelIndexList ancestors;
+        bool result = false;
+        for (QModelIndex ancestor = proxyIndex.parent(); ancestor.isValid(); ancestor = ancestor.parent()) {
+            const auto it = underChangedParents.constFind(ancestor);
+            if (it != underChangedParents.constEnd()) {
+                result = it.value();
+                break;
+            }
+            ancestors.append(ancestor);
+            if (changedParents.contains(ancestor)) {
+                result = true;
+                break;
+            }
+        }
+        for (const QModelIndex &ancestor : std::as_const(ancestors)) {
+            underChangedParents.insert(ancestor, result);
+        }
+        return result;
+    };
 
-    for (QModelIndex proxyPersistentIndex : persistentIndexList) {
-        proxyIndexes << proxyPersistentIndex;
+    const int sourceColumnCount = q->sourceModel()->columnCount();
+    const QModelIndexList persistentIndexList = q->persistentIndexList();
+    if (allChanged) {
+        m_layoutChangeIndexes.reserve(persistentIndexList.size());
+    }
+    for (const QModelIndex &proxyPersistentIndex : persistentIndexList) {
         Q_ASSERT(proxyPersistentIndex.isValid());
-        const int column = proxyPersistentIndex.column();
-        layoutChangeProxyColumns << column;
-        if (column >= q->sourceModel()->columnCount()) {
-            proxyPersistentIndex = proxyPersistentIndex.sibling(proxyPersistentIndex.row(), 0);
+        if (!allChanged && !isUnderChangedParent(proxyPersistentIndex)) {
+            continue;
         }
-        const QPersistentModelIndex srcPersistentIndex = q->mapToSource(proxyPersistentIndex);
+        QModelIndex proxyIndex = proxyPersistentIndex;
+        if (proxyIndex.column() >= sourceColumnCount) {
+            proxyIndex = proxyIndex.sibling(proxyIndex.row(), 0);
+        }
+        const QPersistentModelIndex srcPersistentIndex = q->mapToSource(proxyIndex);
         Q_ASSERT(srcPersistentIndex.isValid());
-        layoutChangePersistentIndexes << srcPersistentIndex;
+        m_layoutChangeIndexes.append({proxyPersistentIndex, srcPersistentIndex});
     }
 }
 
 void KExtraColumnsProxyModelPrivate::_ec_sourceLayoutChanged(const QList<QPersistentModelIndex> &sourceParents, QAbstractItemModel::LayoutChangeHint hint)
 {
     Q_Q(KExtraColumnsProxyModel);
-    for (int i = 0; i < proxyIndexes.size(); ++i) {
-        const QModelIndex proxyIdx = proxyIndexes.at(i);
-        QModelIndex newProxyIdx = q->mapFromSource(layoutChangePersistentIndexes.at(i));
-        if (proxyIdx.column() >= q->sourceModel()->columnCount()) {
-            newProxyIdx = newProxyIdx.sibling(newProxyIdx.row(), layoutChangeProxyColumns.at(i));
+    clearExtraColumnData();
+
+    const int sourceColumnCount = q->sourceModel()->columnCount();
+    QModelIndexList from;
+    QModelIndexList to;
+    from.reserve(m_layoutChangeIndexes.size());
+    to.reserve(m_layoutChangeIndexes.size());
+    for (const LayoutChangeIndex &layoutChangeIndex : std::as_const(m_layoutChangeIndexes)) {
+        const QModelIndex &proxyIdx = layoutChangeIndex.proxyIndex;
+        QModelIndex newProxyIdx = q->mapFromSource(layoutChangeIndex.sourceIndex);
+        if (proxyIdx.column() >= sourceColumnCount) {
+            newProxyIdx = newProxyIdx.sibling(newProxyIdx.row(), proxyIdx.column());
         }
-        q->changePersistentIndex(proxyIdx, newProxyIdx);
+        from.append(proxyIdx);
+        to.append(newProxyIdx);
     }
-
-    layoutChangePersistentIndexes.clear();
-    layoutChangeProxyColumns.clear();
-    proxyIndexes.clear();
+    q->changePersistentIndexList(from, to);
+    m_layoutChangeIndexes.clear();
 
     QList<QPersistentModelIndex> parents;
     parents.reserve(sourceParents.size());
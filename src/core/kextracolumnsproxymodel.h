@@ -11,6 +11,7 @@
 #include "kitemmodels_export.h"
 #include <QIdentityProxyModel>
 
+#include <functional>
 #include <memory>
 
 class KExtraColumnsProxyModelPrivate;
@@ -24,7 +25,7 @@ class KExtraColumnsProxyModelPrivate;
  * It also supports editing, and propagating changes from the source model.
  * Row insertion/removal, column insertion/removal in the source model are supported.
  *
- * Not supported: adding/removing extra columns at runtime; having a different number of columns in subtrees;
+ * Not supported: having a different number of columns in subtrees;
  * drag-n-drop support in the extra columns; moving columns.
  *
  * Derive from KExtraColumnsProxyModel, call appendColumn() (typically in the constructor) for each extra column,
@@ -53,20 +54,64 @@ public:
      *
      * \a header an optional text for the horizontal header
      *
-     * This does not emit any signals - do it in the initial setup phase
+     * This is usually done in the initial setup phase. Once a source model is set,
+     * this emits columnsAboutToBeInserted() and columnsInserted() (since 6.30).
      */
     void appendColumn(const QString &header = QString());
 
+    /*!
+     * Inserts an extra column before the extra column \a idx.
+     *
+     * \a idx index of the extra column (starting from 0), or extraColumnCount() to append
+     *
+     * \a header an optional text for the horizontal header
+     *
+     * Once a source model is set, this emits columnsAboutToBeInserted() and columnsInserted(),
+     * and the persistent indexes of the following extra columns are moved, so that optional
+     * columns can be shown at runtime without resetting the model.
+     *
+     * The extra column data which was cached, see setExtraColumnDataCacheSize(), and the
+     * values of asyncExtraColumnData() are discarded.
+     *
+     * \since 6.30
+     */
+    void insertExtraColumn(int idx, const QString &header = QString());
+
     /*!
      * Removes an extra column.
      *
      * \a idx index of the extra column (starting from 0).
      *
-     * This does not emit any signals - do it in the initial setup phase
+     * Once a source model is set, this emits columnsAboutToBeRemoved() and columnsRemoved()
+     * (since 6.30), and the persistent indexes of the following extra columns are moved.
      * \since 5.24
      */
     void removeExtraColumn(int idx);
 
+    /*!
+     * Returns the number of extra columns.
+     *
+     * \since 6.30
+     */
+    int extraColumnCount() const;
+
+    /*!
+     * Declares that the data of \a extraColumn is computed from the \a sourceColumns of the same row.
+     *
+     * When the source model emits dataChanged() for any of these columns, the proxy also
+     * emits dataChanged() for the extra column, so that it doesn't need to be notified separately
+     * with extraColumnDataChanged(). If \a roles isn't empty, only changes of these roles
+     * are extended; a change without roles is always extended.
+     *
+     * The source change is forwarded with its roles, followed by one signal without roles
+     * for each run of adjacent dependent extra columns.
+     *
+     * \a extraColumn the number of the extra column, starting at 0
+     *
+     * \since 6.30
+     */
+    void setExtraColumnDependencies(int extraColumn, const QList<int> &sourceColumns, const QList<int> &roles = {});
+
     /*!
      * This method is called by data() for extra columns.
      * Reimplement this method to return the data for the extra columns.
@@ -110,6 +155,30 @@ public:
      */
     int proxyColumnForExtraColumn(int extraColumn) const;
 
+    /*!
+     * Enables caching the values returned by extraColumnData(), for up to \a rowCount rows.
+     *
+     * When the cache is full, the rows which were used least recently are dropped first.
+     * Cached values are invalidated automatically when the source model emits dataChanged()
+     * for their row, when rows are inserted, removed or moved before their row under the
+     * same parent or among its descendants, on the other structural changes of the source
+     * model, and when extraColumnDataChanged() is called for their row.
+     *
+     * This is useful when extraColumnData() is expensive, as views call data() many times
+     * for each painted row. The default is 0, which disables the cache.
+     *
+     * \since 6.30
+     */
+    void setExtraColumnDataCacheSize(int rowCount);
+
+    /*!
+     * Returns the maximum number of rows whose extra column data is cached.
+     *
+     * \sa setExtraColumnDataCacheSize()
+     * \since 6.30
+     */
+    int extraColumnDataCacheSize() const;
+
     // Implementation
     void setSourceModel(QAbstractItemModel *model) override;
     QModelIndex mapToSource(const QModelIndex &proxyIndex) const override;
@@ -125,6 +194,33 @@ public:
     QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const override;
     QModelIndex parent(const QModelIndex &child) const override;
 
+protected:
+    /*!
+     * Computes the data of an extra column in another thread.
+     *
+     * Call this from extraColumnData() for values which are too expensive to compute in the
+     * GUI thread. The first call for a cell starts \a job in QThreadPool::globalInstance()
+     * and returns \a placeholder, as do the calls while the job is running. Once it
+     * finished, the proxy emits dataChanged() for the cell, coalesced with the other cells
+     * which finished meanwhile, and this method returns the result of \a job.
+     *
+     * \a job runs in another thread, so it must not access the models: capture the values
+     * it needs by copy instead. The results are invalidated like those cached by
+     * setExtraColumnDataCacheSize(), and only those of the 1000 most recently used rows
+     * are kept: the jobs are started again if they are needed afterwards. The jobs of rows
+     * which are moved or removed, or whose data changes, are cancelled and their results discarded.
+     *
+     * \a parent, \a row, \a extraColumn and \a role are the arguments of extraColumnData().
+     *
+     * \since 6.30
+     */
+    QVariant asyncExtraColumnData(const QModelIndex &parent,
+                                  int row,
+                                  int extraColumn,
+                                  int role,
+                                  const std::function<QVariant()> &job,
+                                  const QVariant &placeholder = QVariant()) const;
+
 private:
     Q_DECLARE_PRIVATE(KExtraColumnsProxyModel)
     Q_PRIVATE_SLOT(d_func(), void _ec_sourceLayoutAboutToBeChanged(const QList<QPersistentModelIndex> &, QAbstractItemModel::LayoutChangeHint))
@@ -11,7 +11,95 @@
 #include "kitemmodels_debug.h"
 #include "kmodelindexproxymapper.h"
 
+#include <QHash>
 #include <QItemSelection>
+#include <QPointer>
+
+#include <algorithm>
+#include <tuple>
+#include <utility>
+
+namespace
+{
+// The rows from top to bottom of a column, under the same parent
+struct ColumnSpan {
+    int column;
+    int top;
+    int bottom;
+};
+
+// Splits the selection in disjoint spans, sorted by column then by row, for each parent
+QHash<QModelIndex, QList<ColumnSpan>> columnSpans(const QItemSelection &selection)
+{
+    QHash<QModelIndex, QList<ColumnSpan>> spansPerParent;
+    for (const QItemSelectionRange &range : selection) {
+        if (!range.isValid()) {
+            continue;
+        }
+        QList<ColumnSpan> &spans = spansPerParent[range.parent()];
+        for (int column = range.left(); column <= range.right(); ++column) {
+            spans.append({column, range.top(), range.bottom()});
+        }
+    }
+    for (QList<ColumnSpan> &spans : spansPerParent) {
+        std::sort(spans.begin(), spans.end(), [](const ColumnSpan &lhs, const ColumnSpan &rhs) {
+            return std::tie(lhs.column, lhs.top) < std::tie(rhs.column, rhs.top);
+        });
+        // Join the overlapping and adjacent spans
+        QList<ColumnSpan> joined;
+        joined.reserve(spans.size());
+        for (const ColumnSpan &span : std::as_const(spans)) {
+            if (!joined.isEmpty() && joined.last().column == span.column && span.top <= joined.last().bottom + 1) {
+                joined.last().bottom = std::max(joined.last().bottom, span.bottom);
+            } else {
+                joined.append(span);
+            }
+        }
+        spans = joined;
+    }
+    return spansPerParent;
+}
+
+// Returns the rows of spans which aren't in removedSpans, both being disjoint and sorted
+QList<ColumnSpan> subtractSpans(const QList<ColumnSpan> &spans, const QList<ColumnSpan> &removedSpans)
+{
+    QList<ColumnSpan> result;
+    auto removed = removedSpans.cbegin();
+    for (ColumnSpan span : spans) {
+        while (removed != removedSpans.cend() && std::tie(removed->column, removed->bottom) < std::tie(span.column, span.top)) {
+            ++removed;
+        }
+        // A removed span can overlap the next span too, so it's not skipped here
+        for (auto it = removed; it != removedSpans.cend() && it->column == span.column && it->top <= span.bottom && span.top <= span.bottom; ++it) {
+            if (it->top > span.top) {
+                result.append({span.column, span.top, it->top - 1});
+            }
+            span.top = std::max(span.top, it->bottom + 1);
+        }
+        if (span.top <= span.bottom) {
+            result.append(span);
+        }
+    }
+    return result;
+}
+
+// Appends the spans to the selection, joining the adjacent columns with the same rows in one range
+void appendSpans(QItemSelection &selection, const QAbstractItemModel *model, const QModelIndex &parent, QList<ColumnSpan> spans)
+{
+    std::sort(spans.begin(), spans.end(), [](const ColumnSpan &lhs, const ColumnSpan &rhs) {
+        return std::tie(lhs.top, lhs.bottom, lhs.column) < std::tie(rhs.top, rhs.bottom, rhs.column);
+    });
+    auto span = spans.cbegin();
+    while (span != spans.cend()) {
+        const ColumnSpan first = *span;
+        int right = first.column;
+        for (++span; span != spans.cend() && span->top == first.top && span->bottom == first.bottom && span->column == right + 1; ++span) {
+            right = span->column;
+        }
+        selection.append(QItemSelectionRange(model->index(first.top, first.column, parent), model->index(first.bottom, right, parent)));
+    }
+}
+}
 
 class KLinkItemSelectionModelPrivate
 {
@@ -44,14 +132,55 @@ public:
 
     void reinitializeIndexMapper()
     {
-        delete m_indexMapper;
-        m_indexMapper = nullptr;
-        if (!q_ptr->model() || !m_linkedItemSelectionModel || !m_linkedItemSelectionModel->model()) {
+        const QAbstractItemModel *model = q_ptr->model();
+        const QAbstractItemModel *linkedModel = m_linkedItemSelectionModel ? m_linkedItemSelectionModel->model() : nullptr;
+        if (!model || !linkedModel) {
+            delete m_indexMapper;
+            m_indexMapper = nullptr;
             return;
         }
-        m_indexMapper = new KModelIndexProxyMapper(q_ptr->model(), m_linkedItemSelectionModel->model(), q_ptr);
+        // The mapper follows changes of the proxies between the two models by itself,
+        // so it only needs to be replaced if one of the models is a different one.
+        if (!m_indexMapper || m_mappedModel != model || m_mappedLinkedModel != linkedModel) {
+            delete m_indexMapper;
+            m_indexMapper = new KModelIndexProxyMapper(model, linkedModel, q_ptr);
+            m_mappedModel = model;
+            m_mappedLinkedModel = linkedModel;
+        }
+        syncSelection();
+    }
+
+    /*
+      Changes the selection to the mapped linked selection, by deselecting and selecting only what differs.
+    */
+    void syncSelection()
+    {
         const QItemSelection mappedSelection = m_indexMapper->mapSelectionRightToLeft(m_linkedItemSelectionModel->selection());
-        q_ptr->QItemSelectionModel::select(mappedSelection, QItemSelectionModel::ClearAndSelect);
+        const QItemSelection currentSelection = q_ptr->selection();
+        if (mappedSelection == currentSelection) {
+            return;
+        }
+
+        // QItemSelection::merge() compares every range with every other one, which is too
+        // slow for large selections: compare the sorted spans of each column instead.
+        const QAbstractItemModel *model = q_ptr->model();
+        const QHash<QModelIndex, QList<ColumnSpan>> mappedSpans = columnSpans(mappedSelection);
+        const QHash<QModelIndex, QList<ColumnSpan>> currentSpans = columnSpans(currentSelection);
+        QItemSelection deselected;
+        for (auto it = currentSpans.cbegin(); it != currentSpans.cend(); ++it) {
+            appendSpans(deselected, model, it.key(), subtractSpans(it.value(), mappedSpans.value(it.key())));
+        }
+        QItemSelection selected;
+        for (auto it = mappedSpans.cbegin(); it != mappedSpans.cend(); ++it) {
+            appendSpans(selected, model, it.key(), subtractSpans(it.value(), currentSpans.value(it.key())));
+        }
+
+        if (!deselected.isEmpty()) {
+            q_ptr->QItemSelectionModel::select(deselected, QItemSelectionModel::Deselect);
+        }
+        if (!selected.isEmpty()) {
+            q_ptr->QItemSelectionModel::select(selected, QItemSelectionModel::Select);
+        }
     }
 
     void sourceSelectionChanged(const QItemSelection &selected, const QItemSelection &deselected);
@@ -61,6 +190,8 @@ public:
     QItemSelectionModel *m_linkedItemSelectionModel = nullptr;
     bool m_ignoreCurrentChanged = false;
     KModelIndexProxyMapper *m_indexMapper = nullptr;
+    QPointer<const QAbstractItemModel> m_mappedModel;
+    QPointer<const QAbstractItemModel> m_mappedLinkedModel;
 };
 
 KLinkItemSelectionModel::KLinkItemSelectionModel(QAbstractItemModel *model, QItemSelectionModel *proxySelector, QObject *parent)
@@ -176,8 +307,12 @@ void KLinkItemSelectionModelPrivate::sourceSelectionChanged(const QItemSelection
     const QItemSelection mappedDeselection = m_indexMapper->mapSelectionRightToLeft(_deselected);
     const QItemSelection mappedSelection = m_indexMapper->mapSelectionRightToLeft(_selected);
 
-    q->QItemSelectionModel::select(mappedDeselection, QItemSelectionModel::Deselect);
-    q->QItemSelectionModel::select(mappedSelection, QItemSelectionModel::Select);
+    if (!mappedDeselection.isEmpty()) {
+        q->QItemSelectionModel::select(mappedDeselection, QItemSelectionModel::Deselect);
+    }
+    if (!mappedSelection.isEmpty()) {
+        q->QItemSelectionModel::select(mappedSelection, QItemSelectionModel::Select);
+    }
 }
 
 void KLinkItemSelectionModelPrivate::sourceCurrentChanged(const QModelIndex &current)
@@ -15,6 +15,8 @@
 #include <QItemSelectionModel>
 #include <QPointer>
 
+#include <vector>
+
 class KModelIndexProxyMapperPrivate
 {
     KModelIndexProxyMapperPrivate(const QAbstractItemModel *leftModel, const QAbstractItemModel *rightModel, KModelIndexProxyMapper *qq)
@@ -27,6 +29,8 @@ class KModelIndexProxyMapperPrivate
     }
 
     void createProxyChain();
+    void resolveChain();
+    static void mapIndexes(QModelIndexList &indexes, const QAbstractProxyModel *proxy, bool toSource);
     void checkConnected();
     void setConnected(bool connected);
 
@@ -47,6 +51,15 @@ class KModelIndexProxyMapperPrivate
     QList<QPointer<const QAbstractProxyModel>> m_proxyChainUp;
     QList<QPointer<const QAbstractProxyModel>> m_proxyChainDown;
 
+    struct ChainLink {
+        const QAbstractProxyModel *proxy;
+        // Whether mapping from left to right goes from this proxy to its source model
+        bool towardsSource;
+    };
+    // m_proxyChainUp followed by m_proxyChainDown, with plain pointers so that mapping doesn't
+    // need to check QPointers. Cleared as soon as one of the proxies is destroyed.
+    std::vector<ChainLink> m_chain;
+
     QPointer<const QAbstractItemModel> m_leftModel;
     QPointer<const QAbstractItemModel> m_rightModel;
 
@@ -92,13 +105,18 @@ class KModelIndexProxyMapperPrivate
 void KModelIndexProxyMapperPrivate::createProxyChain()
 {
     for (auto p : std::as_const(m_proxyChainUp)) {
-        p->disconnect(q_ptr);
+        if (p) {
+            p->disconnect(q_ptr);
+        }
     }
     for (auto p : std::as_const(m_proxyChainDown)) {
-        p->disconnect(q_ptr);
+        if (p) {
+            p->disconnect(q_ptr);
+        }
     }
     m_proxyChainUp.clear();
     m_proxyChainDown.clear();
+    m_chain.clear();
     QPointer<const QAbstractItemModel> targetModel = m_rightModel;
 
     QList<QPointer<const QAbstractProxyModel>> proxyChainDown;
@@ -113,6 +131,7 @@ void KModelIndexProxyMapperPrivate::createProxyChain()
 
         if (selectionTargetProxyModel == m_leftModel) {
             m_proxyChainDown = proxyChainDown;
+            resolveChain();
             checkConnected();
             return;
         }
@@ -133,14 +152,33 @@ void KModelIndexProxyMapperPrivate::createProxyChain()
 
         if (targetIndex != -1) {
             m_proxyChainDown = proxyChainDown.mid(targetIndex + 1, proxyChainDown.size());
+            resolveChain();
             checkConnected();
             return;
         }
     }
     m_proxyChainDown = proxyChainDown;
+    resolveChain();
     checkConnected();
 }
 
+void KModelIndexProxyMapperPrivate::resolveChain()
+{
+    m_chain.reserve(m_proxyChainUp.size() + m_proxyChainDown.size());
+    for (const auto &proxy : std::as_const(m_proxyChainUp)) {
+        m_chain.push_back({proxy.data(), true});
+    }
+    for (const auto &proxy : std::as_const(m_proxyChainDown)) {
+        m_chain.push_back({proxy.data(), false});
+    }
+    for (const ChainLink &link : m_chain) {
+        QObject::connect(link.proxy, &QObject::destroyed, q_ptr, [this] {
+            m_chain.clear();
+            setConnected(false);
+        });
+    }
+}
+
 void KModelIndexProxyMapperPrivate::checkConnected()
 {
     auto konamiRight = m_proxyChainUp.isEmpty() ? m_leftModel : m_proxyChainUp.last()->sourceModel();
@@ -157,6 +195,27 @@ void KModelIndexProxyMapperPrivate::setConnected(bool connected)
     }
 }
 
+void KModelIndexProxyMapperPrivate::mapIndexes(QModelIndexList &indexes, const QAbstractProxyModel *proxy, bool toSource)
+{
+    // Each index is mapped on its own, only an index which repeats the previous one is mapped once.
+    // The columns of a row can't be derived from each other, proxies like KRearrangeColumnsProxyModel
+    // map each column differently.
+    QModelIndex previousIndex;
+    QModelIndex previousMapped;
+    for (QModelIndex &index : indexes) {
+        if (!index.isValid()) {
+            continue;
+        }
+        if (index == previousIndex) {
+            index = previousMapped;
+            continue;
+        }
+        previousIndex = index;
+        index = toSource ? proxy->mapToSource(index) : proxy->mapFromSource(index);
+        previousMapped = index;
+    }
+}
+
 KModelIndexProxyMapper::KModelIndexProxyMapper(const QAbstractItemModel *leftModel, const QAbstractItemModel *rightModel, QObject *parent)
     : QObject(parent)
     , d_ptr(new KModelIndexProxyMapperPrivate(leftModel, rightModel, this))
@@ -167,22 +226,84 @@ KModelIndexProxyMapper::~KModelIndexProxyMapper() = default;
 
 QModelIndex KModelIndexProxyMapper::mapLeftToRight(const QModelIndex &index) const
 {
-    const QItemSelection selection = mapSelectionLeftToRight(QItemSelection(index, index));
-    if (selection.isEmpty()) {
+    Q_D(const KModelIndexProxyMapper);
+
+    if (!index.isValid() || !d->mConnected) {
         return QModelIndex();
     }
 
-    return selection.indexes().first();
+    if (index.model() != d->m_leftModel) {
+        qCDebug(KITEMMODELS_LOG) << "FAIL" << index.model() << d->m_leftModel << d->m_rightModel;
+    }
+    Q_ASSERT(index.model() == d->m_leftModel);
+
+    // Unlike mapSelectionLeftToRight(), this doesn't need to create a selection in each model.
+    QModelIndex seekIndex = index;
+    for (const auto &link : d->m_chain) {
+        seekIndex = link.towardsSource ? link.proxy->mapToSource(seekIndex) : link.proxy->mapFromSource(seekIndex);
+        if (!seekIndex.isValid()) {
+            return QModelIndex();
+        }
+    }
+
+    Q_ASSERT(seekIndex.model() == d->m_rightModel);
+    return seekIndex;
 }
 
 QModelIndex KModelIndexProxyMapper::mapRightToLeft(const QModelIndex &index) const
 {
-    const QItemSelection selection = mapSelectionRightToLeft(QItemSelection(index, index));
-    if (selection.isEmpty()) {
+    Q_D(const KModelIndexProxyMapper);
+
+    if (!index.isValid() || !d->mConnected) {
         return QModelIndex();
     }
 
-    return selection.indexes().first();
+    if (index.model() != d->m_rightModel) {
+        qCDebug(KITEMMODELS_LOG) << "FAIL" << index.model() << d->m_leftModel << d->m_rightModel;
+    }
+    Q_ASSERT(index.model() == d->m_rightModel);
+
+    QModelIndex seekIndex = index;
+    for (auto it = d->m_chain.crbegin(); it != d->m_chain.crend(); ++it) {
+        seekIndex = it->towardsSource ? it->proxy->mapFromSource(seekIndex) : it->proxy->mapToSource(seekIndex);
+        if (!seekIndex.isValid()) {
+            return QModelIndex();
+        }
+    }
+
+    Q_ASSERT(seekIndex.model() == d->m_leftModel);
+    return seekIndex;
+}
+
+QModelIndexList KModelIndexProxyMapper::mapLeftToRight(const QModelIndexList &indexes) const
+{
+    Q_D(const KModelIndexProxyMapper);
+
+    if (!d->mConnected) {
+        return QModelIndexList(indexes.size());
+    }
+
+    // Map the whole list through one proxy after the other, rather than each index through the chain.
+    QModelIndexList result = indexes;
+    for (const auto &link : d->m_chain) {
+        d->mapIndexes(result, link.proxy, link.towardsSource);
+    }
+    return result;
+}
+
+QModelIndexList KModelIndexProxyMapper::mapRightToLeft(const QModelIndexList &indexes) const
+{
+    Q_D(const KModelIndexProxyMapper);
+
+    if (!d->mConnected) {
+        return QModelIndexList(indexes.size());
+    }
+
+    QModelIndexList result = indexes;
+    for (auto it = d->m_chain.crbegin(); it != d->m_chain.crend(); ++it) {
+        d->mapIndexes(result, it->proxy, !it->towardsSource);
+    }
+    return result;
 }
 
 QItemSelection KModelIndexProxyMapper::mapSelectionLeftToRight(const QItemSelection &selection) const
@@ -200,31 +321,17 @@ QItemSelection KModelIndexProxyMapper::mapSelectionLeftToRight(const QItemSelect
 
     QItemSelection seekSelection = selection;
     Q_ASSERT(d->assertSelectionValid(seekSelection));
-    QListIterator<QPointer<const QAbstractProxyModel>> iUp(d->m_proxyChainUp);
-
-    while (iUp.hasNext()) {
-        const QPointer<const QAbstractProxyModel> proxy = iUp.next();
-        if (!proxy) {
-            return QItemSelection();
-        }
-
-        Q_ASSERT(seekSelection.isEmpty() || seekSelection.first().model() == proxy);
-        seekSelection = proxy->mapSelectionToSource(seekSelection);
-        Q_ASSERT(seekSelection.isEmpty() || seekSelection.first().model() == proxy->sourceModel());
-
-        Q_ASSERT(d->assertSelectionValid(seekSelection));
-    }
 
-    QListIterator<QPointer<const QAbstractProxyModel>> iDown(d->m_proxyChainDown);
-
-    while (iDown.hasNext()) {
-        const QPointer<const QAbstractProxyModel> proxy = iDown.next();
-        if (!proxy) {
-            return QItemSelection();
+    for (const auto &link : d->m_chain) {
+        if (link.towardsSource) {
+            Q_ASSERT(seekSelection.isEmpty() || seekSelection.first().model() == link.proxy);
+            seekSelection = link.proxy->mapSelectionToSource(seekSelection);
+            Q_ASSERT(seekSelection.isEmpty() || seekSelection.first().model() == link.proxy->sourceModel());
+        } else {
+            Q_ASSERT(seekSelection.isEmpty() || seekSelection.first().model() == link.proxy->sourceModel());
+            seekSelection = link.proxy->mapSelectionFromSource(seekSelection);
+            Q_ASSERT(seekSelection.isEmpty() || seekSelection.first().model() == link.proxy);
         }
-        Q_ASSERT(seekSelection.isEmpty() || seekSelection.first().model() == proxy->sourceModel());
-        seekSelection = proxy->mapSelectionFromSource(seekSelection);
-        Q_ASSERT(seekSelection.isEmpty() || seekSelection.first().model() == proxy);
 
         Q_ASSERT(d->assertSelectionValid(seekSelection));
     }
@@ -248,28 +355,13 @@ QItemSelection KModelIndexProxyMapper::mapSelectionRightToLeft(const QItemSelect
 
     QItemSelection seekSelection = selection;
     Q_ASSERT(d->assertSelectionValid(seekSelection));
-    QListIterator<QPointer<const QAbstractProxyModel>> iDown(d->m_proxyChainDown);
-
-    iDown.toBack();
-    while (iDown.hasPrevious()) {
-        const QPointer<const QAbstractProxyModel> proxy = iDown.previous();
-        if (!proxy) {
-            return QItemSelection();
-        }
-        seekSelection = proxy->mapSelectionToSource(seekSelection);
-
-        Q_ASSERT(d->assertSelectionValid(seekSelection));
-    }
-
-    QListIterator<QPointer<const QAbstractProxyModel>> iUp(d->m_proxyChainUp);
 
-    iUp.toBack();
-    while (iUp.hasPrevious()) {
-        const QPointer<const QAbstractProxyModel> proxy = iUp.previous();
-        if (!proxy) {
-            return QItemSelection();
+    for (auto it = d->m_chain.crbegin(); it != d->m_chain.crend(); ++it) {
+        if (it->towardsSource) {
+            seekSelection = it->proxy->mapSelectionFromSource(seekSelection);
+        } else {
+            seekSelection = it->proxy->mapSelectionToSource(seekSelection);
         }
-        seekSelection = proxy->mapSelectionFromSource(seekSelection);
 
         Q_ASSERT(d->assertSelectionValid(seekSelection));
     }
@@ -10,6 +10,7 @@
 #ifndef KMODELINDEXPROXYMAPPER_H
 #define KMODELINDEXPROXYMAPPER_H
 
+#include <QModelIndexList>
 #include <QObject>
 
 #include "kitemmodels_export.h"
@@ -78,7 +79,8 @@ class KITEMMODELS_EXPORT KModelIndexProxyMapper : public QObject
      *
      * Indicates whether there is a chain that can be followed from leftModel to rightModel.
      *
-     * This value can change if the sourceModel of an intermediate proxy is changed.
+     * This value can change if the sourceModel of an intermediate proxy is changed,
+     * or if an intermediate proxy is destroyed.
      */
     Q_PROPERTY(bool isConnected READ isConnected NOTIFY isConnectedChanged)
 public:
@@ -99,6 +101,30 @@ public:
      */
     QModelIndex mapRightToLeft(const QModelIndex &index) const;
 
+    /*!
+     * Maps the \a indexes from the left model to the right model.
+     *
+     * Unlike calling mapLeftToRight() for each index, this maps an index
+     * which repeats the previous one only once.
+     * The returned list has the same size and order as \a indexes.
+     * Indexes which can't be mapped are invalid in it.
+     *
+     * \since 6.30
+     */
+    QModelIndexList mapLeftToRight(const QModelIndexList &indexes) const;
+
+    /*!
+     * Maps the \a indexes from the right model to the left model.
+     *
+     * Unlike calling mapRightToLeft() for each index, this maps an index
+     * which repeats the previous one only once.
+     * The returned list has the same size and order as \a indexes.
+     * Indexes which can't be mapped are invalid in it.
+     *
+     * \since 6.30
+     */
+    QModelIndexList mapRightToLeft(const QModelIndexList &indexes) const;
+
     /*!
      * Maps the \a selection from the left model to the right model.
      */
@@ -6,23 +6,173 @@
 
 #include "knumbermodel.h"
 
-#include <QtMath>
+#include <QCache>
 
+#include <algorithm>
 #include <cmath>
+#include <limits>
+
+// The number of display strings kept, enough for a few screens of a picker
+static const int s_displayTextCacheSize = 512;
+
+// The most decimals of the values computed in fixed point
+static const int s_maxDecimals = 9;
+
+// Converts \a value to a fixed point number with \a scale, if it has few enough decimals.
+// Integers up to 2^53 are exact in a qreal, so are their quotients by the scale.
+static bool toFixedPoint(qreal value, qint64 scale, qint64 *fixedPoint)
+{
+    const qreal scaled = value * scale;
+    const qreal rounded = std::round(scaled);
+    // Tolerate the rounding errors of the qreal representation, e.g. of 0.1 * 3
+    if (!(std::abs(rounded) < qreal(1LL << 53)) || std::abs(scaled - rounded) > std::abs(scaled) * 1e-12) {
+        return false;
+    }
+    *fixedPoint = qint64(rounded);
+    return true;
+}
+
+// The values of the model as fixed point numbers, all with the same scale, if they have few enough decimals.
+// The maximum value doesn't take part, so that changing it never changes the existing values.
+struct FixedPointRange {
+    bool isValid = false;
+    qint64 scale = 1;
+    qint64 minimumValue = 0;
+    qint64 stepSize = 0;
+
+    static FixedPointRange fromValues(qreal minimumValue, qreal stepSize)
+    {
+        FixedPointRange range;
+        for (int decimals = 0; decimals <= s_maxDecimals; ++decimals, range.scale *= 10) {
+            if (toFixedPoint(minimumValue, range.scale, &range.minimumValue) && toFixedPoint(stepSize, range.scale, &range.stepSize)) {
+                range.isValid = true;
+                return range;
+            }
+        }
+        return {};
+    }
+};
 
 class KNumberModelPrivate
 {
 public:
+    static int computeRowCount(qreal minimumValue, qreal maximumValue, qreal stepSize, const FixedPointRange &fixedPoint);
+    qreal value(int row) const;
+    int row(qreal value) const;
+    QString displayText(int row, qreal value) const;
+    void updateFixedPoint();
+    void updateLocale() const;
+
     qreal minimumValue = 0.0;
     qreal maximumValue = 0.0;
     qreal stepSize = 1.0;
     QLocale::NumberOptions formattingOptions = QLocale::DefaultNumberOptions;
+
+    // The same values in fixed point, so that the steps don't accumulate rounding errors
+    FixedPointRange fixedPoint;
+    int rowCount = 1;
+
+    // The default locale the formatting locale was built from, to notice when it changes
+    mutable QLocale defaultLocale;
+    // The default locale with the formatting options
+    mutable QLocale locale;
+    // The most recently used display strings, by row
+    mutable QCache<int, QString> displayTexts{s_displayTextCacheSize};
 };
 
+int KNumberModelPrivate::computeRowCount(qreal minimumValue, qreal maximumValue, qreal stepSize, const FixedPointRange &fixedPoint)
+{
+    if (stepSize == 0) {
+        return 1;
+    }
+    // 1 initial entry (the minimumValue) + the number of valid steps afterwards, as many as an int allows
+    constexpr int maxSteps = std::numeric_limits<int>::max() - 1;
+    if (fixedPoint.isValid) {
+        qint64 fixedMaximumValue;
+        if (toFixedPoint(maximumValue, fixedPoint.scale, &fixedMaximumValue)) {
+            const qint64 steps = (fixedMaximumValue - fixedPoint.minimumValue) / fixedPoint.stepSize;
+            return 1 + int(std::clamp<qint64>(steps, 0, maxSteps));
+        }
+        // The maximum has more decimals than the scale, so it's never reached exactly
+        const qreal steps = std::floor((maximumValue * fixedPoint.scale - fixedPoint.minimumValue) / fixedPoint.stepSize);
+        if (!(steps > 0)) {
+            return 1;
+        }
+        return 1 + int(std::min<qreal>(steps, maxSteps));
+    }
+    const qreal steps = std::floor((maximumValue - minimumValue) / stepSize);
+    if (!(steps > 0)) {
+        return 1;
+    }
+    return 1 + int(std::min<qreal>(steps, maxSteps));
+}
+
+qreal KNumberModelPrivate::value(int row) const
+{
+    if (fixedPoint.isValid) {
+        return qreal(fixedPoint.minimumValue + fixedPoint.stepSize * row) / fixedPoint.scale;
+    }
+    return minimumValue + stepSize * row;
+}
+
+int KNumberModelPrivate::row(qreal value) const
+{
+    if (stepSize == 0) {
+        return value == minimumValue ? 0 : -1;
+    }
+    if (fixedPoint.isValid) {
+        qint64 fixedValue;
+        if (!toFixedPoint(value, fixedPoint.scale, &fixedValue)) {
+            return -1;
+        }
+        const qint64 offset = fixedValue - fixedPoint.minimumValue;
+        if (offset % fixedPoint.stepSize != 0) {
+            return -1;
+        }
+        const qint64 row = offset / fixedPoint.stepSize;
+        return row >= 0 && row < rowCount ? int(row) : -1;
+    }
+    const qreal steps = (value - minimumValue) / stepSize;
+    const qreal row = std::round(steps);
+    if (!(std::abs(steps - row) <= 1e-6) || row < 0 || row >= rowCount) {
+        return -1;
+    }
+    return int(row);
+}
+
+void KNumberModelPrivate::updateFixedPoint()
+{
+    fixedPoint = FixedPointRange::fromValues(minimumValue, stepSize);
+    rowCount = computeRowCount(minimumValue, maximumValue, stepSize, fixedPoint);
+}
+
+void KNumberModelPrivate::updateLocale() const
+{
+    defaultLocale = QLocale();
+    locale = defaultLocale;
+    locale.setNumberOptions(formattingOptions);
+    displayTexts.clear();
+}
+
+QString KNumberModelPrivate::displayText(int row, qreal value) const
+{
+    // Comparing locales is cheap, unlike setting the number options
+    if (QLocale() != defaultLocale) {
+        updateLocale();
+    }
+    if (const QString *text = displayTexts.object(row)) {
+        return *text;
+    }
+    const QString text = locale.toString(value);
+    displayTexts.insert(row, new QString(text));
+    return text;
+}
+
 KNumberModel::KNumberModel(QObject *parent)
     : QAbstractListModel(parent)
     , d(new KNumberModelPrivate)
 {
+    d->updateLocale();
 }
 
 KNumberModel::~KNumberModel()
@@ -36,6 +186,8 @@ void KNumberModel::setMinimumValue(qreal minimumValue)
     }
     beginResetModel();
     d->minimumValue = minimumValue;
+    d->updateFixedPoint();
+    d->displayTexts.clear();
     endResetModel();
     Q_EMIT minimumValueChanged();
 }
@@ -50,9 +202,24 @@ void KNumberModel::setMaximumValue(qreal maximumValue)
     if (maximumValue == d->maximumValue) {
         return;
     }
-    beginResetModel();
-    d->maximumValue = maximumValue;
-    endResetModel();
+    // The existing values don't change, only rows at the end come or go
+    const int oldRowCount = d->rowCount;
+    const int newRowCount = KNumberModelPrivate::computeRowCount(d->minimumValue, maximumValue, d->stepSize, d->fixedPoint);
+    const auto setMaximumValue = [&] {
+        d->maximumValue = maximumValue;
+        d->rowCount = newRowCount;
+    };
+    if (newRowCount > oldRowCount) {
+        beginInsertRows(QModelIndex(), oldRowCount, newRowCount - 1);
+        setMaximumValue();
+        endInsertRows();
+    } else if (newRowCount < oldRowCount) {
+        beginRemoveRows(QModelIndex(), newRowCount, oldRowCount - 1);
+        setMaximumValue();
+        endRemoveRows();
+    } else {
+        setMaximumValue();
+    }
     Q_EMIT maximumValueChanged();
 }
 
@@ -68,6 +235,8 @@ void KNumberModel::setStepSize(qreal stepSize)
     }
     beginResetModel();
     d->stepSize = stepSize;
+    d->updateFixedPoint();
+    d->displayTexts.clear();
     endResetModel();
     Q_EMIT stepSizeChanged();
 }
@@ -83,11 +252,9 @@ void KNumberModel::setFormattingOptions(QLocale::NumberOptions formattingOptions
         return;
     }
     d->formattingOptions = formattingOptions;
+    d->updateLocale();
 
-    if (rowCount() == 0) {
-        return;
-    }
-    dataChanged(index(0, 0, QModelIndex()), index(rowCount(), 0, QModelIndex()), QList<int>{DisplayRole});
+    Q_EMIT dataChanged(index(0, 0, QModelIndex()), index(rowCount() - 1, 0, QModelIndex()), QList<int>{DisplayRole});
     Q_EMIT formattingOptionsChanged();
 }
 
@@ -101,7 +268,13 @@ qreal KNumberModel::value(const QModelIndex &index) const
     if (!index.isValid()) {
         return 0.0;
     }
-    return d->minimumValue + d->stepSize * index.row();
+    return d->value(index.row());
+}
+
+QModelIndex KNumberModel::indexForValue(qreal value) const
+{
+    const int row = d->row(value);
+    return row < 0 ? QModelIndex() : index(row, 0);
 }
 
 int KNumberModel::rowCount(const QModelIndex &index) const
@@ -109,21 +282,14 @@ int KNumberModel::rowCount(const QModelIndex &index) const
     if (index.parent().isValid()) {
         return 0;
     }
-    if (d->stepSize == 0) {
-        return 1;
-    }
-    // 1 initial entry (the minimumValue) + the number of valid steps afterwards
-    return 1 + std::max(0, qFloor((d->maximumValue - d->minimumValue) / d->stepSize));
+    return d->rowCount;
 }
 
 QVariant KNumberModel::data(const QModelIndex &index, int role) const
 {
     switch (role) {
-    case KNumberModel::DisplayRole: {
-        auto locale = QLocale();
-        locale.setNumberOptions(d->formattingOptions);
-        return QVariant(locale.toString(value(index)));
-    }
+    case KNumberModel::DisplayRole:
+        return QVariant(d->displayText(index.row(), value(index)));
     case KNumberModel::ValueRole:
         return QVariant(value(index));
     }
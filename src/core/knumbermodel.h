@@ -26,6 +26,11 @@ class KNumberModelPrivate;
  *     \li display - the number represented as a string
  *     \li value - the actual value as a number
  * \endlist
+ *
+ * When the minimum value and the step size both have at most 9 decimals, the values are
+ * computed exactly in fixed point, so that fine steps over large ranges don't accumulate
+ * rounding errors. The number of rows is limited to the largest \c int.
+ *
  * \since 5.65
  */
 class KITEMMODELS_EXPORT KNumberModel : public QAbstractListModel
@@ -50,6 +55,8 @@ class KITEMMODELS_EXPORT KNumberModel : public QAbstractListModel
      * \note  If \c maximumValue is a multiple of \c stepSize added to \c minimumValue
      * it will be included. Otherwise it will not be reached.
      * E.g. in a model with a \c minimumValue of 0.0, a \c maximumValue of 1.0 and a \c stepSize of 0.3, the final row will be 0.9.
+     *
+     * Since 6.30, changing it inserts or removes rows at the end instead of resetting the model.
      */
     Q_PROPERTY(qreal maximumValue READ maximumValue WRITE setMaximumValue NOTIFY maximumValueChanged)
     /*!
@@ -103,6 +110,16 @@ public:
      */
     qreal value(const QModelIndex &index) const;
 
+    /*!
+     * Returns the index of the row whose value is \a value,
+     * or an invalid index if no row has this value.
+     *
+     * This doesn't search the rows, so it's fast for any number of rows.
+     *
+     * \since 6.30
+     */
+    QModelIndex indexForValue(qreal value) const;
+
     int rowCount(const QModelIndex &index = QModelIndex()) const override;
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
     QHash<int, QByteArray> roleNames() const override;
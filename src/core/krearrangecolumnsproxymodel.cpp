@@ -7,10 +7,41 @@
 
 #include "krearrangecolumnsproxymodel.h"
 
+#include <QHash>
+
+#include <algorithm>
+
+// Returns the proxy column of each source column, -1 for the ones which aren't shown
+static QList<int> proxyColumnsFor(const QList<int> &sourceColumns)
+{
+    QList<int> proxyColumns;
+    for (int proxyColumn = 0; proxyColumn < sourceColumns.size(); ++proxyColumn) {
+        const int sourceColumn = sourceColumns.at(proxyColumn);
+        if (sourceColumn < 0) {
+            continue;
+        }
+        if (sourceColumn >= proxyColumns.size()) {
+            proxyColumns.resize(sourceColumn + 1, -1);
+        }
+        if (proxyColumns.at(sourceColumn) < 0) {
+            proxyColumns[sourceColumn] = proxyColumn;
+        }
+    }
+    return proxyColumns;
+}
+
 class KRearrangeColumnsProxyModelPrivate
 {
 public:
+    void setSourceColumns(const QList<int> &columns)
+    {
+        m_sourceColumns = columns;
+        m_proxyColumns = proxyColumnsFor(columns);
+    }
+
     QList<int> m_sourceColumns;
+    // The inverse of m_sourceColumns, indexed by source column
+    QList<int> m_proxyColumns;
     bool m_resetting = false;
     QMetaObject::Connection m_sourceModelAboutToBeResetConnection;
     QMetaObject::Connection m_sourceModelResetConnection;
@@ -41,13 +72,139 @@ void KRearrangeColumnsProxyModel::setSourceModel(QAbstractItemModel *sourceModel
 
 void KRearrangeColumnsProxyModel::setSourceColumns(const QList<int> &columns)
 {
-    // We could use layoutChanged() here, but we would have to map persistent
-    // indexes from the old to the new location...
-    if (!d_ptr->m_resetting)
+    if (d_ptr->m_resetting) {
+        d_ptr->setSourceColumns(columns);
+        return;
+    }
+    if (columns == d_ptr->m_sourceColumns) {
+        return;
+    }
+    // Without columns there are no indexes and no children at all, so going from or to
+    // that state can only be a reset.
+    if (!sourceModel() || columns.isEmpty() || d_ptr->m_sourceColumns.isEmpty()) {
         beginResetModel();
-    d_ptr->m_sourceColumns = columns;
-    if (!d_ptr->m_resetting)
+        d_ptr->setSourceColumns(columns);
         endResetModel();
+        return;
+    }
+
+    // Otherwise the change is split into the removal of the columns which are no longer
+    // shown, a horizontal layout change for the ones which move, and the insertion of the
+    // new ones, so that views keep their state and only update the affected columns.
+    // Column signals are emitted for the toplevel only; the persistent indexes further
+    // down the tree are moved along explicitly, as they aren't covered by those signals.
+    // A source column can be shown several times: its copies are matched in order, the n-th
+    // copy before the change is the n-th copy afterwards.
+    QHash<int, int> newCounts;
+    for (const int sourceColumn : columns) {
+        ++newCounts[sourceColumn];
+    }
+    // Moves the persistent indexes to the new proxy column of their current one, -1 for removed
+    const auto remapPersistentIndexes = [this](const QList<int> &newProxyColumns, bool childrenOnly) {
+        const QModelIndexList persistentIndexes = persistentIndexList();
+        QModelIndexList from;
+        QModelIndexList to;
+        for (const QModelIndex &proxyIndex : persistentIndexes) {
+            if (childrenOnly && !proxyIndex.parent().isValid()) {
+                continue;
+            }
+            const int proxyColumn = newProxyColumns.at(proxyIndex.column());
+            if (proxyColumn == proxyIndex.column()) {
+                continue;
+            }
+            from.append(proxyIndex);
+            to.append(proxyColumn < 0 ? QModelIndex() : createIndex(proxyIndex.row(), proxyColumn, proxyIndex.internalPointer()));
+        }
+        changePersistentIndexList(from, to);
+    };
+
+    // Remove the copies which are no longer shown, last block first
+    QList<bool> removed(d_ptr->m_sourceColumns.size());
+    {
+        QHash<int, int> seen;
+        for (int proxyColumn = 0; proxyColumn < removed.size(); ++proxyColumn) {
+            const int sourceColumn = d_ptr->m_sourceColumns.at(proxyColumn);
+            removed[proxyColumn] = ++seen[sourceColumn] > newCounts.value(sourceColumn);
+        }
+    }
+    for (int last = removed.size() - 1; last >= 0; --last) {
+        if (!removed.at(last)) {
+            continue;
+        }
+        int first = last;
+        while (first > 0 && removed.at(first - 1)) {
+            --first;
+        }
+        const int count = last - first + 1;
+        QList<int> newProxyColumns;
+        for (int proxyColumn = 0; proxyColumn < d_ptr->m_sourceColumns.size(); ++proxyColumn) {
+            newProxyColumns.append(proxyColumn < first ? proxyColumn : proxyColumn <= last ? -1 : proxyColumn - count);
+        }
+        QList<int> remainingColumns = d_ptr->m_sourceColumns;
+        remainingColumns.remove(first, count);
+        beginRemoveColumns(QModelIndex(), first, last);
+        remapPersistentIndexes(newProxyColumns, true);
+        d_ptr->setSourceColumns(remainingColumns);
+        endRemoveColumns();
+        last = first;
+    }
+
+    // Reorder the remaining copies
+    QHash<int, int> remainingCounts;
+    for (const int sourceColumn : std::as_const(d_ptr->m_sourceColumns)) {
+        ++remainingCounts[sourceColumn];
+    }
+    QList<bool> kept(columns.size());
+    QList<int> keptColumns;
+    // The proxy columns of each source column after the reordering
+    QHash<int, QList<int>> keptProxyColumns;
+    {
+        QHash<int, int> seen;
+        for (int proxyColumn = 0; proxyColumn < columns.size(); ++proxyColumn) {
+            const int sourceColumn = columns.at(proxyColumn);
+            kept[proxyColumn] = ++seen[sourceColumn] <= remainingCounts.value(sourceColumn);
+            if (kept.at(proxyColumn)) {
+                keptProxyColumns[sourceColumn].append(keptColumns.size());
+                keptColumns.append(sourceColumn);
+            }
+        }
+    }
+    if (keptColumns != d_ptr->m_sourceColumns) {
+        QList<int> newProxyColumns;
+        QHash<int, int> seen;
+        for (const int sourceColumn : std::as_const(d_ptr->m_sourceColumns)) {
+            newProxyColumns.append(keptProxyColumns.value(sourceColumn).at(seen[sourceColumn]++));
+        }
+        Q_EMIT layoutAboutToBeChanged({}, QAbstractItemModel::HorizontalSortHint);
+        remapPersistentIndexes(newProxyColumns, false);
+        d_ptr->setSourceColumns(keptColumns);
+        Q_EMIT layoutChanged({}, QAbstractItemModel::HorizontalSortHint);
+    }
+
+    // Insert the new copies, which are the only differences left
+    for (int first = 0; first < columns.size(); ++first) {
+        if (kept.at(first)) {
+            continue;
+        }
+        int last = first;
+        while (last + 1 < columns.size() && !kept.at(last + 1)) {
+            ++last;
+        }
+        const int count = last - first + 1;
+        QList<int> newProxyColumns;
+        for (int proxyColumn = 0; proxyColumn < d_ptr->m_sourceColumns.size(); ++proxyColumn) {
+            newProxyColumns.append(proxyColumn < first ? proxyColumn : proxyColumn + count);
+        }
+        QList<int> extendedColumns = d_ptr->m_sourceColumns;
+        extendedColumns.insert(first, count, -1);
+        std::copy(columns.cbegin() + first, columns.cbegin() + last + 1, extendedColumns.begin() + first);
+        beginInsertColumns(QModelIndex(), first, last);
+        remapPersistentIndexes(newProxyColumns, true);
+        d_ptr->setSourceColumns(extendedColumns);
+        endInsertColumns();
+        first = last;
+    }
+    Q_ASSERT(d_ptr->m_sourceColumns == columns);
 }
 
 int KRearrangeColumnsProxyModel::columnCount(const QModelIndex &parent) const
@@ -171,8 +328,10 @@ QModelIndex KRearrangeColumnsProxyModel::mapToSource(const QModelIndex &proxyInd
 
 int KRearrangeColumnsProxyModel::proxyColumnForSourceColumn(int sourceColumn) const
 {
-    // If this is too slow, we could add a second QList with index=logical_source_column value=desired_pos_in_proxy.
-    return d_ptr->m_sourceColumns.indexOf(sourceColumn);
+    if (sourceColumn < 0 || sourceColumn >= d_ptr->m_proxyColumns.size()) {
+        return -1;
+    }
+    return d_ptr->m_proxyColumns.at(sourceColumn);
 }
 
 int KRearrangeColumnsProxyModel::sourceColumnForProxyColumn(int proxyColumn) const
@@ -10,6 +10,7 @@
 
 #include <QItemSelectionRange>
 #include <QPointer>
+#include <QSet>
 #include <QStringList>
 
 #include "kbihash_p.h"
@@ -20,6 +21,39 @@ typedef KBiHash<QPersistentModelIndex, QModelIndex> SourceProxyIndexMapping;
 typedef KBiHash<void *, QModelIndex> ParentMapping;
 typedef KHash2Map<QPersistentModelIndex, int> SourceIndexProxyRowMapping;
 
+/*
+  For each source parent, the source rows of its roots with their top level rows in the proxy, sorted by source row.
+*/
+typedef QHash<QModelIndex, QList<std::pair<int, int>>> RootRowsPerParent;
+
+/*
+  A source index identified by the rows of its ancestors, starting at the top level of the source model.
+  Used instead of QPersistentModelIndex for parent mappings if lazy parent mappings are enabled.
+*/
+typedef QList<int> SourcePath;
+typedef KBiHash<SourcePath, QModelIndex> SourcePathProxyIndexMapping;
+
+static SourcePath sourcePath(const QModelIndex &index)
+{
+    SourcePath path;
+    for (QModelIndex idx = index; idx.isValid(); idx = idx.parent()) {
+        path.prepend(idx.row());
+    }
+    return path;
+}
+
+static QModelIndex indexForSourcePath(const QAbstractItemModel *model, const SourcePath &path)
+{
+    QModelIndex idx;
+    for (const int row : path) {
+        idx = model->index(row, 0, idx);
+        if (!idx.isValid()) {
+            break;
+        }
+    }
+    return idx;
+}
+
 /*
   Return true if idx is a descendant of one of the indexes in list.
   Note that this returns false if list contains idx.
@@ -385,12 +419,29 @@ static QItemSelection kNormalizeSelection(QItemSelection selection)
     return stableNormalizeSelection(selection);
 }
 
+/*
+  Appends range to selection, or extends the last range of selection if range directly follows it.
+ */
+static void appendMergedRange(QItemSelection &selection, const QItemSelectionRange &range)
+{
+    if (!selection.isEmpty()) {
+        QItemSelectionRange &last = selection.last();
+        if (last.model() == range.model() && last.left() == range.left() && last.right() == range.right() && last.bottom() + 1 == range.top()
+            && last.parent() == range.parent()) {
+            last = QItemSelectionRange(last.topLeft(), range.bottomRight());
+            return;
+        }
+    }
+    selection.append(range);
+}
+
 class KSelectionProxyModelPrivate
 {
 public:
     KSelectionProxyModelPrivate(KSelectionProxyModel *model)
         : q_ptr(model)
         , m_indexMapper(nullptr)
+        , m_lazyParentMappings(false)
         , m_startWithChildTrees(false)
         , m_omitChildren(false)
         , m_omitDescendants(false)
@@ -405,6 +456,8 @@ public:
         , m_layoutChanging(false)
         , m_ignoreNextLayoutAboutToBeChanged(false)
         , m_ignoreNextLayoutChanged(false)
+        , m_toggledTopLevelRows(-1)
+        , m_togglingToFlat(false)
         , m_selectionModel(nullptr)
         , m_filterBehavior(KSelectionProxyModel::InvalidBehavior)
     {
@@ -422,6 +475,10 @@ public:
     // This mapping maps indexes with children in the source to indexes with children in the proxy.
     // The order of indexes in this list is not relevant.
     mutable SourceProxyIndexMapping m_mappedParents;
+    // Used instead of m_mappedParents if m_lazyParentMappings is true. Source parents are keyed by their
+    // row path, so no persistent indexes are created in the source model for them. The paths are updated
+    // when rows are inserted into or removed from the source model.
+    mutable SourcePathProxyIndexMapping m_mappedParentPaths;
 
     KVoidPointerFactory<> m_voidPointerFactory;
 
@@ -438,6 +495,14 @@ public:
       offset is the amount that affected indexes will be changed.
     */
     void updateInternalIndexes(const QModelIndex &parent, int start, int offset);
+    template<typename Mapping>
+    void updateInternalIndexes(Mapping &mappedParents, const QModelIndex &parent, int start, int offset);
+
+    /*
+      Updates the paths in m_mappedParentPaths after rows start to end were inserted into or removed from
+      sourceParent. Mappings of removed parents are dropped.
+    */
+    void updateMappedParentPaths(const QModelIndex &sourceParent, int start, int end, bool removed);
 
     /*
      * Updates stored indexes in the proxy. Any proxy row >= start is changed by offset.
@@ -455,6 +520,40 @@ public:
         return m_omitChildren || (m_omitDescendants && m_startWithChildTrees);
     }
 
+    /*
+      Returns whether the children of proxyParent are omitted from the proxy.
+
+      This is the same as isFlat(), except for the top level rows while toggleTopLevelChildren() switches them.
+    */
+    bool omitsChildren(const QModelIndex &proxyParent) const
+    {
+        if (m_toggledTopLevelRows >= 0 && proxyParent.internalPointer() == nullptr) {
+            return m_togglingToFlat == (proxyParent.row() < m_toggledTopLevelRows);
+        }
+        return isFlat();
+    }
+
+    /*
+      Sets m_filterBehavior and the flags derived from it, without changing the content of the proxy.
+    */
+    void applyFilterBehavior(KSelectionProxyModel::FilterBehavior behavior);
+
+    /*
+      Removes or inserts the children of each top level row, one row after the other.
+
+      This switches between the SubTrees and SubTreeRoots behaviors, which have the same roots.
+      The flags of the SubTrees behavior must be set while this runs.
+    */
+    void toggleTopLevelChildren(bool omitChildren);
+
+    /*
+      Removes or inserts the selected indexes which are descendants of other selected indexes.
+
+      This switches between the SubTreeRoots and ExactSelection behaviors, which are both flat.
+      The flags of the ExactSelection behavior must be set while this runs.
+    */
+    void toggleNestedSelectedRoots(bool include);
+
     /*
      * Tries to ensure that parent is a mapped parent in the proxy.
      * Returns true if parent is mappable in the model, and false otherwise.
@@ -479,6 +578,7 @@ public:
     void createFirstChildMapping(const QModelIndex &parent, int proxyRow) const;
     bool firstChildAlreadyMapped(const QModelIndex &firstChild) const;
     bool parentAlreadyMapped(const QModelIndex &parent) const;
+    void insertParentMapping(const QModelIndex &sourceParent, const QModelIndex &proxyParent) const;
     void removeFirstChildMappings(int start, int end);
     void removeParentMappings(const QModelIndex &parent, int start, int end);
 
@@ -505,6 +605,12 @@ public:
 
     QModelIndex mapTopLevelToSource(int row, int column) const;
     QModelIndex mapTopLevelFromSource(const QModelIndex &sourceIndex) const;
+
+    /*
+      Appends to proxySelection the top level rows of the proxy which correspond to root indexes in the source range.
+      rootRows is built by the first call, and reused for the other ranges of the same selection.
+    */
+    void mapTopLevelRangeFromSource(const QItemSelectionRange &range, RootRowsPerParent &rootRows, QItemSelection &proxySelection) const;
     QModelIndex createTopLevelIndex(int row, int column) const;
     int topLevelRowCount() const;
 
@@ -526,6 +632,8 @@ public:
 
     KModelIndexProxyMapper *m_indexMapper;
 
+    bool m_lazyParentMappings;
+
     QPair<int, int> beginRemoveRows(const QModelIndex &parent, int start, int end) const;
     QPair<int, int> beginInsertRows(const QModelIndex &parent, int start, int end) const;
     void endRemoveRows(const QModelIndex &sourceParent, int proxyStart, int proxyEnd);
@@ -539,8 +647,22 @@ public:
     void sourceRowsMoved(const QModelIndex &parent, int start, int end, const QModelIndex &destParent, int destRow);
     void sourceModelAboutToBeReset();
     void sourceModelReset();
-    void sourceLayoutAboutToBeChanged();
+    void sourceLayoutAboutToBeChanged(const QList<QPersistentModelIndex> &sourceParents = QList<QPersistentModelIndex>(),
+                                      QAbstractItemModel::LayoutChangeHint hint = QAbstractItemModel::NoLayoutChangeHint);
     void sourceLayoutChanged();
+
+    /*
+      Returns true if the children of the source index parent are part of the proxy.
+    */
+    bool childrenInProxy(const QModelIndex &parent) const;
+
+    /*
+      If only the children of parents which are already mapped in the proxy are sorted, the roots and all other
+      mappings stay the same. Only the mapped children of those parents and the persistent indexes among them
+      are updated instead of recreating the whole mapping.
+    */
+    void beginScopedLayoutChange(const QList<QPersistentModelIndex> &sourceParents);
+    void endScopedLayoutChange();
     void emitContinuousRanges(const QModelIndex &sourceFirst, const QModelIndex &sourceLast, const QModelIndex &proxyFirst, const QModelIndex &proxyLast);
     void sourceDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight);
 
@@ -590,6 +712,10 @@ public:
     bool m_layoutChanging;
     bool m_ignoreNextLayoutAboutToBeChanged;
     bool m_ignoreNextLayoutChanged;
+
+    int m_toggledTopLevelRows;
+    bool m_togglingToFlat;
+
     QPointer<QItemSelectionModel> m_selectionModel;
 
     KSelectionProxyModel::FilterBehavior m_filterBehavior;
@@ -597,6 +723,17 @@ public:
     QList<QPersistentModelIndex> m_layoutChangePersistentIndexes;
     QModelIndexList m_proxyIndexes;
 
+    struct ScopedLayoutChange {
+        QPersistentModelIndex sourceParent;
+        void *parentId = nullptr;
+        // Only used with lazy parent mappings. The paths of mapped descendants contain the rows of the
+        // sorted children, so the children on those paths are tracked by their old row.
+        SourcePath parentPath;
+        QHash<int, QPersistentModelIndex> children;
+    };
+    QList<ScopedLayoutChange> m_scopedLayoutChanges;
+    QList<QPersistentModelIndex> m_layoutChangeProxyParents;
+
     struct PendingSelectionChange {
         PendingSelectionChange()
         {
@@ -736,7 +873,21 @@ void KSelectionProxyModelPrivate::sourceDataChanged(const QModelIndex &topLeft,
     }
 }
 
-void KSelectionProxyModelPrivate::sourceLayoutAboutToBeChanged()
+bool KSelectionProxyModelPrivate::childrenInProxy(const QModelIndex &parent) const
+{
+    if (m_omitChildren) {
+        return false;
+    }
+    if (m_rootIndexList.contains(parent)) {
+        return true;
+    }
+    if (m_omitDescendants) {
+        return false;
+    }
+    return isDescendantOf(m_rootIndexList, parent);
+}
+
+void KSelectionProxyModelPrivate::sourceLayoutAboutToBeChanged(const QList<QPersistentModelIndex> &sourceParents, QAbstractItemModel::LayoutChangeHint hint)
 {
     Q_Q(KSelectionProxyModel);
 
@@ -749,6 +900,50 @@ void KSelectionProxyModelPrivate::sourceLayoutAboutToBeChanged()
         return;
     }
 
+    if (!sourceParents.isEmpty()) {
+        // A change of the order of the children of an ancestor of a root can change the order of the roots.
+        QSet<QModelIndex> rootAncestors;
+        for (const auto &rootIndex : std::as_const(m_rootIndexList)) {
+            for (QModelIndex ancestor = rootIndex.parent(); ancestor.isValid() && !rootAncestors.contains(ancestor); ancestor = ancestor.parent()) {
+                rootAncestors.insert(ancestor);
+            }
+        }
+
+        bool scoped = (hint == QAbstractItemModel::VerticalSortHint);
+        QList<QPersistentModelIndex> affectedParents;
+        for (const QPersistentModelIndex &sourceParent : sourceParents) {
+            if (!sourceParent.isValid() || rootAncestors.contains(sourceParent)) {
+                scoped = false;
+                affectedParents.append(sourceParent);
+                continue;
+            }
+            if (!childrenInProxy(sourceParent)) {
+                continue;
+            }
+            if (!parentAlreadyMapped(sourceParent)) {
+                // If the parent is not mapped, there can't be any mappings or proxy indexes for its children.
+                // Its children might be in the top level of the proxy though.
+                if (m_rootIndexList.contains(sourceParent)) {
+                    scoped = false;
+                    affectedParents.append(sourceParent);
+                }
+                continue;
+            }
+            affectedParents.append(sourceParent);
+        }
+
+        if (affectedParents.isEmpty()) {
+            // Nothing in the proxy changes.
+            m_ignoreNextLayoutChanged = true;
+            return;
+        }
+
+        if (scoped) {
+            beginScopedLayoutChange(affectedParents);
+            return;
+        }
+    }
+
     Q_EMIT q->layoutAboutToBeChanged();
 
     QItemSelection selection;
@@ -774,6 +969,142 @@ void KSelectionProxyModelPrivate::sourceLayoutAboutToBeChanged()
     m_rootIndexList.clear();
 }
 
+void KSelectionProxyModelPrivate::beginScopedLayoutChange(const QList<QPersistentModelIndex> &sourceParents)
+{
+    Q_Q(KSelectionProxyModel);
+
+    QSet<void *> parentIds;
+    for (const QPersistentModelIndex &sourceParent : sourceParents) {
+        const QModelIndex proxyParent = mapParentFromSource(sourceParent);
+        Q_ASSERT(proxyParent.isValid());
+
+        ScopedLayoutChange change;
+        change.sourceParent = sourceParent;
+        change.parentId = m_parentIds.rightToLeft(proxyParent);
+        if (m_lazyParentMappings) {
+            change.parentPath = sourcePath(sourceParent);
+        }
+        parentIds.insert(change.parentId);
+        m_scopedLayoutChanges.append(change);
+        m_layoutChangeProxyParents.append(proxyParent);
+    }
+
+    if (m_lazyParentMappings) {
+        SourcePathProxyIndexMapping::left_const_iterator it = m_mappedParentPaths.leftConstBegin();
+        const SourcePathProxyIndexMapping::left_const_iterator end = m_mappedParentPaths.leftConstEnd();
+        for (; it != end; ++it) {
+            const SourcePath &path = it.key();
+            for (ScopedLayoutChange &change : m_scopedLayoutChanges) {
+                const int depth = change.parentPath.size();
+                if (path.size() <= depth || change.children.contains(path.at(depth))
+                    || !std::equal(change.parentPath.cbegin(), change.parentPath.cend(), path.cbegin())) {
+                    continue;
+                }
+                change.children.insert(path.at(depth), QPersistentModelIndex(q->sourceModel()->index(path.at(depth), 0, change.sourceParent)));
+            }
+        }
+    }
+
+    Q_EMIT q->layoutAboutToBeChanged(m_layoutChangeProxyParents, QAbstractItemModel::VerticalSortHint);
+
+    // Indexes deeper than the children of the sorted parents keep their row and parent id.
+    const auto lst = q->persistentIndexList();
+    for (const QModelIndex &proxyPersistentIndex : lst) {
+        if (!parentIds.contains(proxyPersistentIndex.internalPointer())) {
+            continue;
+        }
+        m_proxyIndexes << proxyPersistentIndex;
+        const QPersistentModelIndex srcPersistentIndex = q->mapToSource(proxyPersistentIndex);
+        Q_ASSERT(srcPersistentIndex.isValid());
+        m_layoutChangePersistentIndexes << srcPersistentIndex;
+    }
+}
+
+void KSelectionProxyModelPrivate::endScopedLayoutChange()
+{
+    Q_Q(KSelectionProxyModel);
+
+    QList<QPair<void *, QModelIndex>> updatedIds;
+
+    if (m_lazyParentMappings) {
+        QList<QPair<SourcePath, QModelIndex>> updatedPaths;
+        SourcePathProxyIndexMapping::left_iterator it = m_mappedParentPaths.leftBegin();
+        while (it != m_mappedParentPaths.leftEnd()) {
+            const SourcePath &path = it.key();
+            SourcePath newPath = path;
+            QModelIndex proxyIndex = it.value();
+            for (const ScopedLayoutChange &change : std::as_const(m_scopedLayoutChanges)) {
+                const int depth = change.parentPath.size();
+                if (path.size() <= depth || !std::equal(change.parentPath.cbegin(), change.parentPath.cend(), path.cbegin())) {
+                    continue;
+                }
+                const QPersistentModelIndex child = change.children.value(path.at(depth));
+                Q_ASSERT(child.isValid());
+                newPath[depth] = child.row();
+                if (path.size() == depth + 1) {
+                    proxyIndex = q->createIndex(child.row(), proxyIndex.column(), change.parentId);
+                }
+            }
+            if (newPath == path) {
+                ++it;
+                continue;
+            }
+            if (proxyIndex != it.value()) {
+                updatedIds.append(qMakePair(m_parentIds.rightToLeft(it.value()), proxyIndex));
+            }
+            updatedPaths.append(qMakePair(newPath, proxyIndex));
+            it = m_mappedParentPaths.eraseLeft(it);
+        }
+        for (const auto &updatedPath : std::as_const(updatedPaths)) {
+            m_mappedParentPaths.insert(updatedPath.first, updatedPath.second);
+        }
+    } else {
+        QList<QPair<QPersistentModelIndex, QModelIndex>> updatedParents;
+        SourceProxyIndexMapping::left_const_iterator it = m_mappedParents.leftConstBegin();
+        const SourceProxyIndexMapping::left_const_iterator end = m_mappedParents.leftConstEnd();
+        for (; it != end; ++it) {
+            const QModelIndex proxyIndex = it.value();
+            for (const ScopedLayoutChange &change : std::as_const(m_scopedLayoutChanges)) {
+                if (proxyIndex.internalPointer() != change.parentId) {
+                    continue;
+                }
+                if (proxyIndex.row() != it.key().row()) {
+                    const QModelIndex newProxyIndex = q->createIndex(it.key().row(), proxyIndex.column(), change.parentId);
+                    updatedParents.append(qMakePair(it.key(), newProxyIndex));
+                    updatedIds.append(qMakePair(m_parentIds.rightToLeft(proxyIndex), newProxyIndex));
+                }
+                break;
+            }
+        }
+        // Remove all stale entries first, as the new proxy indexes may still be used by other entries.
+        for (const auto &updatedParent : std::as_const(updatedParents)) {
+            m_mappedParents.removeLeft(updatedParent.first);
+        }
+        for (const auto &updatedParent : std::as_const(updatedParents)) {
+            m_mappedParents.insert(updatedParent.first, updatedParent.second);
+        }
+    }
+
+    for (const auto &updatedId : std::as_const(updatedIds)) {
+        m_parentIds.removeLeft(updatedId.first);
+    }
+    for (const auto &updatedId : std::as_const(updatedIds)) {
+        m_parentIds.insert(updatedId.first, updatedId.second);
+    }
+
+    for (int i = 0; i < m_proxyIndexes.size(); ++i) {
+        q->changePersistentIndex(m_proxyIndexes.at(i), q->mapFromSource(m_layoutChangePersistentIndexes.at(i)));
+    }
+
+    m_layoutChangePersistentIndexes.clear();
+    m_proxyIndexes.clear();
+    m_scopedLayoutChanges.clear();
+
+    const QList<QPersistentModelIndex> proxyParents = std::move(m_layoutChangeProxyParents);
+    m_layoutChangeProxyParents.clear();
+    Q_EMIT q->layoutChanged(proxyParents, QAbstractItemModel::VerticalSortHint);
+}
+
 void KSelectionProxyModelPrivate::sourceLayoutChanged()
 {
     Q_Q(KSelectionProxyModel);
@@ -783,6 +1114,11 @@ void KSelectionProxyModelPrivate::sourceLayoutChanged()
         return;
     }
 
+    if (!m_scopedLayoutChanges.isEmpty()) {
+        endScopedLayoutChange();
+        return;
+    }
+
     if (!m_selectionModel || !m_selectionModel->hasSelection()) {
         return;
     }
@@ -800,6 +1136,7 @@ void KSelectionProxyModelPrivate::sourceLayoutChanged()
     m_rootIndexList.clear();
     m_mappedFirstChildren.clear();
     m_mappedParents.clear();
+    m_mappedParentPaths.clear();
     m_parentIds.clear();
 
     m_resetting = true;
@@ -823,7 +1160,10 @@ void KSelectionProxyModelPrivate::resetInternalData()
     m_rootIndexList.clear();
     m_layoutChangePersistentIndexes.clear();
     m_proxyIndexes.clear();
+    m_scopedLayoutChanges.clear();
+    m_layoutChangeProxyParents.clear();
     m_mappedParents.clear();
+    m_mappedParentPaths.clear();
     m_parentIds.clear();
     m_mappedFirstChildren.clear();
     m_voidPointerFactory.clear();
@@ -1061,6 +1401,10 @@ void KSelectionProxyModelPrivate::sourceRowsInserted(const QModelIndex &parent,
 
     Q_ASSERT(parent.isValid() ? parent.model() == q->sourceModel() : true);
 
+    if (m_lazyParentMappings) {
+        updateMappedParentPaths(parent, start, end, false);
+    }
+
     if (!m_rowsInserted) {
         return;
     }
@@ -1258,11 +1602,13 @@ void KSelectionProxyModelPrivate::endRemoveRows(const QModelIndex &sourceParent,
 void KSelectionProxyModelPrivate::sourceRowsRemoved(const QModelIndex &parent, int start, int end)
 {
     Q_Q(KSelectionProxyModel);
-    Q_UNUSED(end)
-    Q_UNUSED(start)
 
     Q_ASSERT(parent.isValid() ? parent.model() == q->sourceModel() : true);
 
+    if (m_lazyParentMappings) {
+        updateMappedParentPaths(parent, start, end, true);
+    }
+
     if (!m_selectionModel) {
         return;
     }
@@ -1311,13 +1657,62 @@ void KSelectionProxyModelPrivate::sourceRowsMoved(const QModelIndex &srcParent,
     sourceLayoutChanged();
 }
 
+void KSelectionProxyModelPrivate::updateMappedParentPaths(const QModelIndex &sourceParent, int start, int end, bool removed)
+{
+    if (m_mappedParentPaths.isEmpty()) {
+        return;
+    }
+
+    const SourcePath parentPath = sourcePath(sourceParent);
+    const int depth = parentPath.size();
+    const int offset = removed ? -(end - start + 1) : (end - start + 1);
+
+    // Collect the shifted paths first, so that they can't collide with paths which are not updated yet.
+    QList<QPair<SourcePath, QModelIndex>> updatedPaths;
+    SourcePathProxyIndexMapping::left_iterator it = m_mappedParentPaths.leftBegin();
+    while (it != m_mappedParentPaths.leftEnd()) {
+        const SourcePath &path = it.key();
+        if (path.size() <= depth || path.at(depth) < start || !std::equal(parentPath.cbegin(), parentPath.cend(), path.cbegin())) {
+            ++it;
+            continue;
+        }
+        if (removed && path.at(depth) <= end) {
+            // The parent or one of its ancestors was removed.
+            m_parentIds.removeRight(it.value());
+        } else {
+            SourcePath newPath = path;
+            newPath[depth] += offset;
+            updatedPaths.append(qMakePair(newPath, it.value()));
+        }
+        it = m_mappedParentPaths.eraseLeft(it);
+    }
+
+    for (const auto &updatedPath : std::as_const(updatedPaths)) {
+        m_mappedParentPaths.insert(updatedPath.first, updatedPath.second);
+    }
+}
+
 QModelIndex KSelectionProxyModelPrivate::mapParentToSource(const QModelIndex &proxyParent) const
 {
+    if (m_lazyParentMappings) {
+        Q_Q(const KSelectionProxyModel);
+        if (!m_mappedParentPaths.rightContains(proxyParent)) {
+            return QModelIndex();
+        }
+        return indexForSourcePath(q->sourceModel(), m_mappedParentPaths.rightToLeft(proxyParent));
+    }
     return m_mappedParents.rightToLeft(proxyParent);
 }
 
 QModelIndex KSelectionProxyModelPrivate::mapParentFromSource(const QModelIndex &sourceParent) const
 {
+    if (m_lazyParentMappings) {
+        // Only indexes in the first column are mapped as parents.
+        if (!sourceParent.isValid() || sourceParent.column() != 0) {
+            return QModelIndex();
+        }
+        return m_mappedParentPaths.leftToRight(sourcePath(sourceParent));
+    }
     return m_mappedParents.leftToRight(sourceParent);
 }
 
@@ -1464,7 +1859,7 @@ bool KSelectionProxyModelPrivate::ensureMappable(const QModelIndex &parent) cons
 
         void *const newId = m_voidPointerFactory.createPointer();
         m_parentIds.insert(newId, newProxyParent);
-        m_mappedParents.insert(QPersistentModelIndex(newSourceParent), newProxyParent);
+        insertParentMapping(newSourceParent, newProxyParent);
         ancestor = newSourceParent;
     }
     return true;
@@ -1494,6 +1889,16 @@ void KSelectionProxyModelPrivate::updateInternalTopIndexes(int start, int offset
 }
 
 void KSelectionProxyModelPrivate::updateInternalIndexes(const QModelIndex &parent, int start, int offset)
+{
+    if (m_lazyParentMappings) {
+        updateInternalIndexes(m_mappedParentPaths, parent, start, offset);
+    } else {
+        updateInternalIndexes(m_mappedParents, parent, start, offset);
+    }
+}
+
+template<typename Mapping>
+void KSelectionProxyModelPrivate::updateInternalIndexes(Mapping &mappedParents, const QModelIndex &parent, int start, int offset)
 {
     Q_Q(KSelectionProxyModel);
 
@@ -1504,12 +1909,12 @@ void KSelectionProxyModelPrivate::updateInternalIndexes(const QModelIndex &paren
         return;
     }
 
-    SourceProxyIndexMapping::left_iterator mappedParentIt = m_mappedParents.leftBegin();
+    typename Mapping::left_iterator mappedParentIt = mappedParents.leftBegin();
 
     QHash<void *, QModelIndex> updatedParentIds;
-    QHash<QPersistentModelIndex, QModelIndex> updatedParents;
+    QHash<typename Mapping::left_type, QModelIndex> updatedParents;
 
-    for (; mappedParentIt != m_mappedParents.leftEnd(); ++mappedParentIt) {
+    for (; mappedParentIt != mappedParents.leftEnd(); ++mappedParentIt) {
         const QModelIndex proxyIndex = mappedParentIt.value();
         Q_ASSERT(proxyIndex.isValid());
 
@@ -1540,10 +1945,10 @@ void KSelectionProxyModelPrivate::updateInternalIndexes(const QModelIndex &paren
     }
 
     {
-        QHash<QPersistentModelIndex, QModelIndex>::const_iterator it = updatedParents.constBegin();
-        const QHash<QPersistentModelIndex, QModelIndex>::const_iterator end = updatedParents.constEnd();
+        typename QHash<typename Mapping::left_type, QModelIndex>::const_iterator it = updatedParents.constBegin();
+        const typename QHash<typename Mapping::left_type, QModelIndex>::const_iterator end = updatedParents.constEnd();
         for (; it != end; ++it) {
-            m_mappedParents.insert(it.key(), it.value());
+            mappedParents.insert(it.key(), it.value());
         }
     }
 
@@ -1561,9 +1966,21 @@ bool KSelectionProxyModelPrivate::parentAlreadyMapped(const QModelIndex &parent)
     Q_Q(const KSelectionProxyModel);
     Q_UNUSED(q) // except in Q_ASSERT
     Q_ASSERT(parent.model() == q->sourceModel());
+    if (m_lazyParentMappings) {
+        return parent.column() == 0 && m_mappedParentPaths.leftContains(sourcePath(parent));
+    }
     return m_mappedParents.leftContains(parent);
 }
 
+void KSelectionProxyModelPrivate::insertParentMapping(const QModelIndex &sourceParent, const QModelIndex &proxyParent) const
+{
+    if (m_lazyParentMappings) {
+        m_mappedParentPaths.insert(sourcePath(sourceParent), proxyParent);
+    } else {
+        m_mappedParents.insert(QPersistentModelIndex(sourceParent), proxyParent);
+    }
+}
+
 bool KSelectionProxyModelPrivate::firstChildAlreadyMapped(const QModelIndex &firstChild) const
 {
     Q_Q(const KSelectionProxyModel);
@@ -1618,7 +2035,7 @@ void KSelectionProxyModelPrivate::createParentMappings(const QModelIndex &parent
         void *const newId = m_voidPointerFactory.createPointer();
         m_parentIds.insert(newId, proxyIndex);
         Q_ASSERT(srcIndex.isValid());
-        m_mappedParents.insert(QPersistentModelIndex(srcIndex), proxyIndex);
+        insertParentMapping(srcIndex, proxyIndex);
     }
 }
 
@@ -1644,12 +2061,23 @@ void KSelectionProxyModelPrivate::removeParentMappings(const QModelIndex &parent
     };
     std::vector<RemovalInfo> removals;
     removals.reserve(end - start + 1);
-    for (auto it = m_mappedParents.rightBegin(); it != m_mappedParents.rightEnd(); ++it) {
-        if (it.key().row() >= start && it.key().row() <= end) {
-            const QModelIndex sourceParent = it.value();
-            const QModelIndex proxyGrandParent = mapParentFromSource(sourceParent.parent());
-            if (proxyGrandParent == parent) {
-                removals.push_back({it.key(), it.value()});
+    if (m_lazyParentMappings) {
+        for (auto it = m_mappedParentPaths.rightConstBegin(); it != m_mappedParentPaths.rightConstEnd(); ++it) {
+            if (it.key().row() >= start && it.key().row() <= end) {
+                const QModelIndex proxyGrandParent = m_mappedParentPaths.leftToRight(it.value().first(it.value().size() - 1));
+                if (proxyGrandParent == parent) {
+                    removals.push_back({it.key(), indexForSourcePath(q->sourceModel(), it.value())});
+                }
+            }
+        }
+    } else {
+        for (auto it = m_mappedParents.rightBegin(); it != m_mappedParents.rightEnd(); ++it) {
+            if (it.key().row() >= start && it.key().row() <= end) {
+                const QModelIndex sourceParent = it.value();
+                const QModelIndex proxyGrandParent = mapParentFromSource(sourceParent.parent());
+                if (proxyGrandParent == parent) {
+                    removals.push_back({it.key(), it.value()});
+                }
             }
         }
     }
@@ -1661,7 +2089,11 @@ void KSelectionProxyModelPrivate::removeParentMappings(const QModelIndex &parent
             removeParentMappings(r.idx, 0, q->sourceModel()->rowCount(r.sourceIdx) - 1);
         }
         m_parentIds.removeRight(r.idx);
-        m_mappedParents.removeRight(r.idx);
+        if (m_lazyParentMappings) {
+            m_mappedParentPaths.removeRight(r.idx);
+        } else {
+            m_mappedParents.removeRight(r.idx);
+        }
     }
 }
 
@@ -1686,6 +2118,45 @@ QModelIndex KSelectionProxyModelPrivate::mapTopLevelToSource(int row, int column
     return sourceFirstChild.sibling(row - proxyFirstRow, column);
 }
 
+void KSelectionProxyModelPrivate::mapTopLevelRangeFromSource(const QItemSelectionRange &range,
+                                                             RootRowsPerParent &rootRows,
+                                                             QItemSelection &proxySelection) const
+{
+    Q_Q(const KSelectionProxyModel);
+    if (rootRows.isEmpty()) {
+        for (int proxyRow = 0; proxyRow < m_rootIndexList.size(); ++proxyRow) {
+            const QPersistentModelIndex &root = m_rootIndexList.at(proxyRow);
+            rootRows[root.parent()].append({root.row(), proxyRow});
+        }
+        for (QList<std::pair<int, int>> &rows : rootRows) {
+            std::sort(rows.begin(), rows.end());
+        }
+    }
+    const auto it = rootRows.constFind(range.parent());
+    if (it == rootRows.cend()) {
+        return;
+    }
+
+    // Roots from other parents may be between them in the proxy, so collect runs of consecutive proxy rows.
+    int firstRow = -1;
+    int lastRow = -1;
+    const auto first = std::lower_bound(it->cbegin(), it->cend(), std::pair<int, int>(range.top(), -1));
+    for (auto row = first; row != it->cend() && row->first <= range.bottom(); ++row) {
+        const int proxyRow = row->second;
+        if (firstRow >= 0 && proxyRow == lastRow + 1) {
+            lastRow = proxyRow;
+            continue;
+        }
+        if (firstRow >= 0) {
+            appendMergedRange(proxySelection, QItemSelectionRange(q->createIndex(firstRow, range.left()), q->createIndex(lastRow, range.right())));
+        }
+        firstRow = lastRow = proxyRow;
+    }
+    if (firstRow >= 0) {
+        appendMergedRange(proxySelection, QItemSelectionRange(q->createIndex(firstRow, range.left()), q->createIndex(lastRow, range.right())));
+    }
+}
+
 void KSelectionProxyModelPrivate::removeSelectionFromProxy(const QItemSelection &selection)
 {
     Q_Q(KSelectionProxyModel);
@@ -1885,6 +2356,7 @@ void KSelectionProxyModelPrivate::selectionChanged(const QItemSelection &_select
         Q_ASSERT(m_rootIndexList.isEmpty());
         Q_ASSERT(m_mappedFirstChildren.isEmpty());
         Q_ASSERT(m_mappedParents.isEmpty());
+        Q_ASSERT(m_mappedParentPaths.isEmpty());
         Q_ASSERT(m_parentIds.isEmpty());
     }
 
@@ -1989,6 +2461,103 @@ void KSelectionProxyModelPrivate::insertSelectionIntoProxy(const QItemSelection
     Q_EMIT q->rootSelectionAdded(selection, KSelectionProxyModel::QPrivateSignal());
 }
 
+void KSelectionProxyModelPrivate::applyFilterBehavior(KSelectionProxyModel::FilterBehavior behavior)
+{
+    m_filterBehavior = behavior;
+
+    switch (behavior) {
+    case KSelectionProxyModel::InvalidBehavior: {
+        Q_ASSERT(!"InvalidBehavior can't be used here");
+        return;
+    }
+    case KSelectionProxyModel::SubTrees: {
+        m_omitChildren = false;
+        m_omitDescendants = false;
+        m_startWithChildTrees = false;
+        m_includeAllSelected = false;
+        break;
+    }
+    case KSelectionProxyModel::SubTreeRoots: {
+        m_omitChildren = true;
+        m_startWithChildTrees = false;
+        m_includeAllSelected = false;
+        break;
+    }
+    case KSelectionProxyModel::SubTreesWithoutRoots: {
+        m_omitChildren = false;
+        m_omitDescendants = false;
+        m_startWithChildTrees = true;
+        m_includeAllSelected = false;
+        break;
+    }
+    case KSelectionProxyModel::ExactSelection: {
+        m_omitChildren = true;
+        m_startWithChildTrees = false;
+        m_includeAllSelected = true;
+        break;
+    }
+    case KSelectionProxyModel::ChildrenOfExactSelection: {
+        m_omitChildren = false;
+        m_omitDescendants = true;
+        m_startWithChildTrees = true;
+        m_includeAllSelected = true;
+        break;
+    }
+    }
+}
+
+void KSelectionProxyModelPrivate::toggleTopLevelChildren(bool omitChildren)
+{
+    Q_Q(KSelectionProxyModel);
+    Q_ASSERT(!m_omitChildren && !m_startWithChildTrees && !m_includeAllSelected);
+
+    // Each top level row is switched in its own batch, so omitsChildren() has to report
+    // the old behavior for the rows which are not switched yet.
+    m_togglingToFlat = omitChildren;
+    m_toggledTopLevelRows = 0;
+    for (int row = 0; row < m_rootIndexList.size(); ++row) {
+        const int childCount = q->sourceModel()->rowCount(m_rootIndexList.at(row));
+        if (childCount == 0) {
+            m_toggledTopLevelRows = row + 1;
+            continue;
+        }
+        const QModelIndex proxyParent = q->createIndex(row, 0);
+        if (omitChildren) {
+            q->beginRemoveRows(proxyParent, 0, childCount - 1);
+            m_toggledTopLevelRows = row + 1;
+            q->endRemoveRows();
+        } else {
+            q->beginInsertRows(proxyParent, 0, childCount - 1);
+            m_toggledTopLevelRows = row + 1;
+            q->endInsertRows();
+        }
+    }
+    m_toggledTopLevelRows = -1;
+
+    if (omitChildren) {
+        // There are no parents in a flat proxy.
+        m_mappedParents.clear();
+        m_mappedParentPaths.clear();
+        m_parentIds.clear();
+    }
+}
+
+void KSelectionProxyModelPrivate::toggleNestedSelectedRoots(bool include)
+{
+    Q_ASSERT(m_omitChildren && !m_startWithChildTrees && m_includeAllSelected);
+
+    const QItemSelection fullSelection = kNormalizeSelection(m_indexMapper->mapSelectionRightToLeft(m_selectionModel->selection()));
+    QItemSelection nestedSelection = fullSelection;
+    nestedSelection.merge(getRootRanges(fullSelection), QItemSelectionModel::Deselect);
+    nestedSelection = kNormalizeSelection(nestedSelection);
+
+    if (include) {
+        insertSelectionIntoProxy(nestedSelection);
+    } else {
+        removeSelectionFromProxy(nestedSelection);
+    }
+}
+
 KSelectionProxyModel::KSelectionProxyModel(QItemSelectionModel *selectionModel, QObject *parent)
     : QAbstractProxyModel(parent)
     , d_ptr(new KSelectionProxyModelPrivate(this))
@@ -2012,58 +2581,46 @@ void KSelectionProxyModel::setFilterBehavior(FilterBehavior behavior)
     if (behavior == InvalidBehavior) {
         return;
     }
-    if (d->m_filterBehavior != behavior) {
-        beginResetModel();
-
-        d->m_filterBehavior = behavior;
+    if (d->m_filterBehavior == behavior) {
+        return;
+    }
 
-        switch (behavior) {
-        case InvalidBehavior: {
-            Q_ASSERT(!"InvalidBehavior can't be used here");
-            return;
-        }
-        case SubTrees: {
-            d->m_omitChildren = false;
-            d->m_omitDescendants = false;
-            d->m_startWithChildTrees = false;
-            d->m_includeAllSelected = false;
-            break;
-        }
-        case SubTreeRoots: {
-            d->m_omitChildren = true;
-            d->m_startWithChildTrees = false;
-            d->m_includeAllSelected = false;
-            break;
-        }
-        case SubTreesWithoutRoots: {
-            d->m_omitChildren = false;
-            d->m_omitDescendants = false;
-            d->m_startWithChildTrees = true;
-            d->m_includeAllSelected = false;
-            break;
-        }
-        case ExactSelection: {
-            d->m_omitChildren = true;
-            d->m_startWithChildTrees = false;
-            d->m_includeAllSelected = true;
-            break;
-        }
-        case ChildrenOfExactSelection: {
-            d->m_omitChildren = false;
-            d->m_omitDescendants = true;
-            d->m_startWithChildTrees = true;
-            d->m_includeAllSelected = true;
-            break;
-        }
+    // SubTrees, SubTreeRoots and ExactSelection all show the selected indexes at the top level.
+    // Switching between them only inserts or removes the rows which differ, going through SubTreeRoots.
+    const auto showsSelectionAtTopLevel = [](FilterBehavior filterBehavior) {
+        return filterBehavior == SubTrees || filterBehavior == SubTreeRoots || filterBehavior == ExactSelection;
+    };
+    if (showsSelectionAtTopLevel(d->m_filterBehavior) && showsSelectionAtTopLevel(behavior) && sourceModel() && d->m_selectionModel && d->m_indexMapper
+        && !d->m_resetting && !d->m_layoutChanging && !d->m_rowsInserted && !d->m_rowsRemoved && !d->m_rowsMoved) {
+        if (d->m_filterBehavior == SubTrees) {
+            d->toggleTopLevelChildren(true);
+        } else if (d->m_filterBehavior == ExactSelection) {
+            d->toggleNestedSelectedRoots(false);
+        }
+        d->applyFilterBehavior(SubTreeRoots);
+
+        if (behavior == SubTrees) {
+            d->applyFilterBehavior(SubTrees);
+            d->toggleTopLevelChildren(false);
+        } else if (behavior == ExactSelection) {
+            d->applyFilterBehavior(ExactSelection);
+            d->toggleNestedSelectedRoots(true);
         }
         Q_EMIT filterBehaviorChanged(QPrivateSignal());
-        d->resetInternalData();
-        if (d->m_selectionModel) {
-            d->selectionChanged(d->m_selectionModel->selection(), QItemSelection());
-        }
+        return;
+    }
+
+    beginResetModel();
 
-        endResetModel();
+    d->applyFilterBehavior(behavior);
+
+    Q_EMIT filterBehaviorChanged(QPrivateSignal());
+    d->resetInternalData();
+    if (d->m_selectionModel) {
+        d->selectionChanged(d->m_selectionModel->selection(), QItemSelection());
     }
+
+    endResetModel();
 }
 
 KSelectionProxyModel::FilterBehavior KSelectionProxyModel::filterBehavior() const
@@ -2072,6 +2629,29 @@ KSelectionProxyModel::FilterBehavior KSelectionProxyModel::filterBehavior() cons
     return d->m_filterBehavior;
 }
 
+void KSelectionProxyModel::setLazyParentMappings(bool lazy)
+{
+    Q_D(KSelectionProxyModel);
+
+    if (d->m_lazyParentMappings == lazy) {
+        return;
+    }
+
+    beginResetModel();
+    d->resetInternalData();
+    d->m_lazyParentMappings = lazy;
+    if (d->m_selectionModel && sourceModel()) {
+        d->selectionChanged(d->m_selectionModel->selection(), QItemSelection());
+    }
+    endResetModel();
+}
+
+bool KSelectionProxyModel::lazyParentMappings() const
+{
+    Q_D(const KSelectionProxyModel);
+    return d->m_lazyParentMappings;
+}
+
 void KSelectionProxyModel::setSourceModel(QAbstractItemModel *_sourceModel)
 {
     Q_D(KSelectionProxyModel);
@@ -2143,9 +2723,12 @@ void KSelectionProxyModel::setSourceModel(QAbstractItemModel *_sourceModel)
             d->sourceDataChanged(topLeft, bottomRight);
         });
 
-        connect(_sourceModel, &QAbstractItemModel::layoutAboutToBeChanged, this, [d]() {
-            d->sourceLayoutAboutToBeChanged();
-        });
+        connect(_sourceModel,
+                &QAbstractItemModel::layoutAboutToBeChanged,
+                this,
+                [d](const QList<QPersistentModelIndex> &parents, QAbstractItemModel::LayoutChangeHint hint) {
+                    d->sourceLayoutAboutToBeChanged(parents, hint);
+                });
 
         connect(_sourceModel, &QAbstractItemModel::layoutChanged, this, [d]() {
             d->sourceLayoutChanged();
@@ -2216,7 +2799,7 @@ int KSelectionProxyModel::rowCount(const QModelIndex &index) const
     }
 
     // index is valid
-    if (d->isFlat()) {
+    if (d->omitsChildren(index)) {
         return 0;
     }
 
@@ -2340,7 +2923,7 @@ bool KSelectionProxyModel::hasChildren(const QModelIndex &parent) const
 
     if (parent.isValid()) {
         Q_ASSERT(parent.model() == this);
-        if (d->isFlat()) {
+        if (d->omitsChildren(parent)) {
             return false;
         }
         return sourceModel()->hasChildren(mapToSource(parent));
@@ -2472,35 +3055,34 @@ QModelIndexList KSelectionProxyModel::match(const QModelIndex &start, int role,
 QItemSelection KSelectionProxyModel::mapSelectionFromSource(const QItemSelection &selection) const
 {
     Q_D(const KSelectionProxyModel);
-    if (!d->m_startWithChildTrees && d->m_includeAllSelected) {
-        // QAbstractProxyModel::mapSelectionFromSource puts invalid ranges in the result
-        // without checking. We can't have that.
-        QItemSelection proxySelection;
-        for (const QItemSelectionRange &range : selection) {
-            QModelIndex proxyTopLeft = mapFromSource(range.topLeft());
-            if (!proxyTopLeft.isValid()) {
-                continue;
-            }
-            QModelIndex proxyBottomRight = mapFromSource(range.bottomRight());
-            Q_ASSERT(proxyBottomRight.isValid());
-            proxySelection.append(QItemSelectionRange(proxyTopLeft, proxyBottomRight));
-        }
+
+    // QAbstractProxyModel::mapSelectionFromSource puts invalid ranges in the result
+    // without checking. We can't have that.
+    QItemSelection proxySelection;
+    if (!sourceModel() || d->m_rootIndexList.isEmpty()) {
         return proxySelection;
     }
+    RootRowsPerParent rootRows;
 
-    QItemSelection proxySelection;
-    QItemSelection::const_iterator it = selection.constBegin();
-    const QItemSelection::const_iterator end = selection.constEnd();
-    for (; it != end; ++it) {
-        const QModelIndex proxyTopLeft = mapFromSource(it->topLeft());
+    for (const QItemSelectionRange &range : selection) {
+        if (!range.isValid()) {
+            continue;
+        }
+        const QModelIndex proxyTopLeft = mapFromSource(range.topLeft());
+        if (!d->m_startWithChildTrees && (!proxyTopLeft.isValid() || !proxyTopLeft.parent().isValid())) {
+            // The range may contain roots which are not contiguous in the proxy, or not start with one.
+            d->mapTopLevelRangeFromSource(range, rootRows, proxySelection);
+            continue;
+        }
         if (!proxyTopLeft.isValid()) {
             continue;
         }
 
-        if (it->height() == 1 && it->width() == 1) {
-            proxySelection.append(QItemSelectionRange(proxyTopLeft, proxyTopLeft));
+        // Siblings which share a parent in the proxy are contiguous in the proxy too.
+        if (range.height() == 1 && range.width() == 1) {
+            appendMergedRange(proxySelection, QItemSelectionRange(proxyTopLeft, proxyTopLeft));
         } else {
-            proxySelection.append(QItemSelectionRange(proxyTopLeft, d->mapFromSource(it->bottomRight())));
+            appendMergedRange(proxySelection, QItemSelectionRange(proxyTopLeft, d->mapFromSource(range.bottomRight())));
         }
     }
     return proxySelection;
@@ -2514,71 +3096,54 @@ QItemSelection KSelectionProxyModel::mapSelectionToSource(const QItemSelection &
         return selection;
     }
 
-    if (!d->m_startWithChildTrees && d->m_includeAllSelected) {
-        // QAbstractProxyModel::mapSelectionFromSource puts invalid ranges in the result
-        // without checking. We can't have that.
-        QItemSelection sourceSelection;
-        for (const QItemSelectionRange &range : selection) {
-            QModelIndex sourceTopLeft = mapToSource(range.topLeft());
-            Q_ASSERT(sourceTopLeft.isValid());
-
-            QModelIndex sourceBottomRight = mapToSource(range.bottomRight());
-            Q_ASSERT(sourceBottomRight.isValid());
-            sourceSelection.append(QItemSelectionRange(sourceTopLeft, sourceBottomRight));
-        }
+    QItemSelection sourceSelection;
+    if (!sourceModel()) {
         return sourceSelection;
     }
 
-    QItemSelection sourceSelection;
-    QItemSelection extraSelection;
-    QItemSelection::const_iterator it = selection.constBegin();
-    const QItemSelection::const_iterator end = selection.constEnd();
-    for (; it != end; ++it) {
-        const QModelIndex sourceTopLeft = mapToSource(it->topLeft());
-        if (it->height() == 1 && it->width() == 1) {
-            sourceSelection.append(QItemSelectionRange(sourceTopLeft, sourceTopLeft));
-        } else if (it->parent().isValid()) {
-            sourceSelection.append(QItemSelectionRange(sourceTopLeft, mapToSource(it->bottomRight())));
-        } else {
-            // A contiguous selection in the proxy might not be contiguous in the source if it
-            // is at the top level of the proxy.
+    for (const QItemSelectionRange &range : selection) {
+        if (!range.isValid()) {
+            continue;
+        }
+        if (range.parent().isValid()) {
+            const QModelIndex sourceTopLeft = mapToSource(range.topLeft());
+            Q_ASSERT(sourceTopLeft.isValid());
+            if (range.height() == 1 && range.width() == 1) {
+                appendMergedRange(sourceSelection, QItemSelectionRange(sourceTopLeft, sourceTopLeft));
+            } else {
+                appendMergedRange(sourceSelection, QItemSelectionRange(sourceTopLeft, mapToSource(range.bottomRight())));
+            }
+            continue;
+        }
+
+        // A contiguous selection in the proxy might not be contiguous in the source if it
+        // is at the top level of the proxy. Split it where the source parent changes or
+        // where consecutive roots are not consecutive in the source.
+        int row = range.top();
+        while (row <= range.bottom()) {
+            const QModelIndex sourceFirst = d->mapTopLevelToSource(row, range.left());
+            Q_ASSERT(sourceFirst.isValid());
+            int lastRow = row;
             if (d->m_startWithChildTrees) {
-                const QModelIndex sourceParent = mapFromSource(sourceTopLeft);
-                Q_ASSERT(sourceParent.isValid());
-                const int rowCount = sourceModel()->rowCount(sourceParent);
-                if (rowCount < it->bottom()) {
-                    Q_ASSERT(sourceTopLeft.isValid());
-                    Q_ASSERT(it->bottomRight().isValid());
-                    const QModelIndex sourceBottomRight = mapToSource(it->bottomRight());
-                    Q_ASSERT(sourceBottomRight.isValid());
-                    sourceSelection.append(QItemSelectionRange(sourceTopLeft, sourceBottomRight));
-                    continue;
-                }
-                // Store the contiguous part...
-                const QModelIndex sourceBottomRight = sourceModel()->index(rowCount - 1, it->right(), sourceParent);
-                Q_ASSERT(sourceTopLeft.isValid());
-                Q_ASSERT(sourceBottomRight.isValid());
-                sourceSelection.append(QItemSelectionRange(sourceTopLeft, sourceBottomRight));
-                // ... and the rest will be processed later.
-                extraSelection.append(QItemSelectionRange(createIndex(it->top() - rowCount, it->right()), it->bottomRight()));
+                // All children of a root are consecutive in the proxy.
+                const int siblingCount = sourceModel()->rowCount(sourceFirst.parent());
+                lastRow = qMin(range.bottom(), row + siblingCount - 1 - sourceFirst.row());
             } else {
-                QItemSelection topSelection;
-                const QModelIndex idx = createIndex(it->top(), it->right());
-                const QModelIndex sourceIdx = mapToSource(idx);
-                Q_ASSERT(sourceIdx.isValid());
-                topSelection.append(QItemSelectionRange(sourceTopLeft, sourceIdx));
-                for (int i = it->top() + 1; i <= it->bottom(); ++i) {
-                    const QModelIndex left = mapToSource(createIndex(i, 0));
-                    const QModelIndex right = mapToSource(createIndex(i, it->right()));
-                    Q_ASSERT(left.isValid());
-                    Q_ASSERT(right.isValid());
-                    topSelection.append(QItemSelectionRange(left, right));
+                const QModelIndex sourceParent = sourceFirst.parent();
+                while (lastRow < range.bottom()) {
+                    const QPersistentModelIndex &nextRoot = d->m_rootIndexList.at(lastRow + 1);
+                    if (nextRoot.row() != sourceFirst.row() + lastRow + 1 - row || nextRoot.parent() != sourceParent) {
+                        break;
+                    }
+                    ++lastRow;
                 }
-                sourceSelection += kNormalizeSelection(topSelection);
             }
+            const QModelIndex sourceLast = sourceFirst.sibling(sourceFirst.row() + lastRow - row, range.right());
+            Q_ASSERT(sourceLast.isValid());
+            appendMergedRange(sourceSelection, QItemSelectionRange(sourceFirst, sourceLast));
+            row = lastRow + 1;
         }
     }
-    sourceSelection << mapSelectionToSource(extraSelection);
     return sourceSelection;
 }
 
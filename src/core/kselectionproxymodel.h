@@ -237,6 +237,32 @@ public:
     void setFilterBehavior(FilterBehavior behavior);
     FilterBehavior filterBehavior() const;
 
+    /*!
+      Sets whether parents in the proxy are mapped to the source model without persistent indexes.
+
+      By default, every source index which is a parent in the proxy is tracked with a
+      QPersistentModelIndex, including all intermediate ancestors of indexes mapped with mapFromSource().
+      With the SubTrees behavior on deep hierarchies, this fills the persistent index table of the source model.
+
+      If \a lazy is true, those parents are identified by the row path to them in the source model instead,
+      which is derived from the parent chain when needed and updated when source rows are inserted or removed.
+      Only the selected root indexes are kept as persistent indexes.
+
+      Changing this resets the model. The default is false.
+
+      \since 6.30
+    */
+    void setLazyParentMappings(bool lazy);
+
+    /*!
+      Returns whether parents in the proxy are mapped to the source model without persistent indexes.
+
+      \sa setLazyParentMappings()
+
+      \since 6.30
+    */
+    bool lazyParentMappings() const;
+
     QModelIndex mapFromSource(const QModelIndex &sourceIndex) const override;
     QModelIndex mapToSource(const QModelIndex &proxyIndex) const override;
 
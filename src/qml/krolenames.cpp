@@ -19,8 +19,15 @@ public:
     {
     }
 
-    QHash<int, QByteArray> roleNames() const;
+    void ensureRoleNames() const;
+    void invalidateRoleNames();
     QAbstractItemModel *model() const;
+
+    // The role names of the model and the reverse mapping, built on first use.
+    // Models may only change their role names on reset, also refreshed on layout changes.
+    mutable QHash<int, QByteArray> roleNames;
+    mutable QHash<QByteArray, int> roles;
+    mutable bool roleNamesValid = false;
 };
 
 KRoleNames::KRoleNames(QObject *parent)
@@ -28,24 +35,30 @@ KRoleNames::KRoleNames(QObject *parent)
     , d(new KRoleNamesPrivate(this))
 {
     Q_ASSERT(parent);
-    if (!d->model()) {
+    const auto model = d->model();
+    if (!model) {
         qmlWarning(parent) << "KRoleNames must be attached to a QAbstractItemModel";
         return;
     }
+    const auto invalidate = [this] {
+        d->invalidateRoleNames();
+    };
+    connect(model, &QAbstractItemModel::modelReset, this, invalidate);
+    connect(model, &QAbstractItemModel::layoutChanged, this, invalidate);
 }
 
 KRoleNames::~KRoleNames() = default;
 
 QByteArray KRoleNames::roleName(int role) const
 {
-    const auto map = d->roleNames();
-    return map.value(role, QByteArray());
+    d->ensureRoleNames();
+    return d->roleNames.value(role, QByteArray());
 }
 
 int KRoleNames::role(const QByteArray &roleName) const
 {
-    const auto map = d->roleNames();
-    return map.key(roleName, -1);
+    d->ensureRoleNames();
+    return d->roles.value(roleName, -1);
 }
 
 KRoleNames *KRoleNames::qmlAttachedProperties(QObject *object)
@@ -53,12 +66,27 @@ KRoleNames *KRoleNames::qmlAttachedProperties(QObject *object)
     return new KRoleNames(object);
 }
 
-QHash<int, QByteArray> KRoleNamesPrivate::roleNames() const
+void KRoleNamesPrivate::ensureRoleNames() const
 {
+    if (roleNamesValid) {
+        return;
+    }
+    roleNamesValid = true;
     if (const auto m = model()) {
-        return m->roleNames();
+        roleNames = m->roleNames();
+    }
+    roles.clear();
+    roles.reserve(roleNames.size());
+    for (auto it = roleNames.cbegin(); it != roleNames.cend(); ++it) {
+        roles.insert(it.value(), it.key());
     }
-    return {};
+}
+
+void KRoleNamesPrivate::invalidateRoleNames()
+{
+    roleNamesValid = false;
+    roleNames.clear();
+    roles.clear();
 }
 
 QAbstractItemModel *KRoleNamesPrivate::model() const
@@ -26,6 +26,9 @@ class KRoleNamesPrivate;
  * via Q_ENUM macro) but role names are known; or just to maintain consistency
  * with view delegates (which use role names as properties).
  *
+ * The role names are fetched from the model once, and again after it is reset
+ * or its layout changes, so lookups are cheap.
+ *
  * \since 6.0
  */
 class KRoleNames : public QObject